@@ -0,0 +1,65 @@
+#pragma once
+#include "component.hpp"
+
+// Counts that systems used to poll with world.count<>() every tick. Player and
+// turret counts are kept up to date by observers, disabled entities included.
+// Asteroid counts are updated where asteroids are spawned and released, since
+// a pooled asteroid only changes stage when it is spawned again.
+struct AggregateIndex {
+    u32 players = 0;
+    u32 readyPlayers = 0;
+    u32 deadPlayers = 0;
+    u32 turrets = 0;
+    u32 asteroids = 0;
+    std::array<u32, 256> asteroidsByStage = {};
+
+    void addAsteroid(u8 stage) {
+        asteroids++;
+        asteroidsByStage[stage]++;
+    }
+
+    void removeAsteroid(u8 stage) {
+        asteroids--;
+        asteroidsByStage[stage]--;
+    }
+
+    void clearAsteroids() {
+        asteroids = 0;
+        asteroidsByStage = {};
+    }
+};
+
+struct AggregateIndexComponent {
+    std::shared_ptr<AggregateIndex> index;
+};
+
+inline AggregateIndex& getAggregateIndex(const flecs::world& world) {
+    return *world.get<AggregateIndexComponent>()->index;
+}
+
+struct AggregateIndexModule {
+    AggregateIndexModule(flecs::world& world) {
+        std::shared_ptr<AggregateIndex> index = std::make_shared<AggregateIndex>();
+        world.set(AggregateIndexComponent{index});
+
+        world.observer<PlayerComponent>().event(flecs::OnAdd).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity, PlayerComponent&) { index->players++; });
+        world.observer<PlayerComponent>().event(flecs::OnRemove).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity, PlayerComponent&) { index->players--; });
+
+        world.observer().with<PlayerReady>().event(flecs::OnAdd).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity) { index->readyPlayers++; });
+        world.observer().with<PlayerReady>().event(flecs::OnRemove).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity) { index->readyPlayers--; });
+
+        world.observer().with<PlayerDead>().event(flecs::OnAdd).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity) { index->deadPlayers++; });
+        world.observer().with<PlayerDead>().event(flecs::OnRemove).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity) { index->deadPlayers--; });
+
+        world.observer<TurretComponent>().event(flecs::OnAdd).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity, TurretComponent&) { index->turrets++; });
+        world.observer<TurretComponent>().event(flecs::OnRemove).filter_flags(EcsFilterMatchDisabled)
+            .each([index](flecs::entity, TurretComponent&) { index->turrets--; });
+    }
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include "base.hpp"
+#include <memory_resource>
+#include <optional>
+
+// Bump allocator for data that only lives for one tick. Every allocation comes
+// out of one preallocated buffer that reset() releases all at once, so steady
+// state play never touches the heap. A tick that needs more than the buffer
+// spills onto the heap and the buffer grows to fit at the next reset.
+class TickArena {
+public:
+    explicit TickArena(size_t capacity)
+        : buffer(capacity) {
+        arena.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+
+    std::pmr::memory_resource* resource() { return &*arena; }
+
+    void reset() {
+        arena.reset();
+
+        if (overflow.bytes > 0) {
+            buffer.resize(buffer.size() + overflow.bytes * 2);
+            overflow.bytes = 0;
+        }
+
+        arena.emplace(buffer.data(), buffer.size(), &overflow);
+    }
+
+private:
+    // hands out heap memory once the buffer is used up and counts how much
+    struct OverflowResource : public std::pmr::memory_resource {
+        size_t bytes = 0;
+
+        void* do_allocate(size_t size, size_t alignment) override {
+            bytes += size;
+            return std::pmr::new_delete_resource()->allocate(size, alignment);
+        }
+
+        void do_deallocate(void* ptr, size_t size, size_t alignment) override {
+            std::pmr::new_delete_resource()->deallocate(ptr, size, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+    };
+
+    std::vector<std::byte> buffer;
+    OverflowResource overflow;
+    std::optional<std::pmr::monotonic_buffer_resource> arena;
+};
+
+// owned by the world whose ticks it serves, so every world progressed on its
+// own thread has its own arena, see getTickArena()
+struct TickArenaComponent {
+    std::shared_ptr<TickArena> arena;
+};
+
+// only used from the thread that progresses the world, reset at the start of every tick
+inline TickArena& getTickArena(const flecs::world& world) {
+    return *world.get<TickArenaComponent>()->arena;
+}
+
+template<typename T>
+using TickVector = std::pmr::vector<T>;
+
+template<typename T>
+TickVector<T> makeTickVector(const flecs::world& world) {
+    return TickVector<T>(getTickArena(world).resource());
+}
+
+struct TickArenaModule {
+    TickArenaModule(flecs::world& world) {
+        world.set(TickArenaComponent{std::make_shared<TickArena>(1 << 20)});
+
+        world.system().kind(flecs::OnLoad).iter([](flecs::iter& iter) {
+            getTickArena(iter.world()).reset();
+        });
+    }
+};
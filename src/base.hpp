@@ -25,11 +25,22 @@ inline struct GameConfig {
     float inputUPS;
     float stateUPS;
     u32 maxAsteroids;
+    u32 workerThreads;
+    float tickBudgetMs;
+    float governorReplicationScale;
+    u32 governorMaxSpawnsPerTick;
+    u32 governorMaxBulletsPerTick;
+    bool autoplay;
+    u32 autoplayMatches;
+    float metricsExportInterval;
 } config;
 
 constexpr u16 AsteroidCollisionMask = 1 << 0;
 constexpr u16 PlayerCollisionMask = 1 << 1;
 
+constexpr float bulletRadius = 5.0f;
+constexpr float bulletLifetime = 1.0f;
+
 constexpr std::initializer_list<sf::Vector2f> playerVertices = {
     {10.0f, -10.0f},
     {-10.0f, 0.0f},
@@ -0,0 +1,261 @@
+#include "scenario.hpp"
+#include "bench.hpp"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Plays whole matches headless and as fast as the machine allows, for tuning
+// GameConfig values. One host player is driven by getBotInput(), the world is
+// stepped with the fixed tick length, and every match is appended as one row
+// to the output CSV (see MatchStats). Match i is seeded with seed + i - 1, so
+// any row can be replayed on its own.
+//
+// Matches are split over jobs. The engine keeps the physics world and the
+// network state manager per process, so each job is a forked process with its
+// own world, writing its own part file that is merged into the output once
+// every job is done. Without fork() there is a single job.
+//
+// usage: asteroids_batch <matches> [seed] [output.csv] [jobs] [name=value ...]
+//   jobs of 0 uses every core, name=value overrides a GameConfig value after
+//   the config file, for example
+//   asteroids_batch 1000 1 spawn_fast.csv 0 timeToRemovePerAsteroidSpawn=0.02
+
+// the GameConfig values a batch can override from the command line
+const std::map<std::string, std::function<void(double)>> configOverrides = {
+    {"playerSpeed", [](double value) { config.playerSpeed = (float)value; }},
+    {"playerFireRate", [](double value) { config.playerFireRate = (float)value; }},
+    {"initialLives", [](double value) { config.initialLives = (int)value; }},
+    {"turretPrice", [](double value) { config.turretPrice = (i32)value; }},
+    {"maxTurrets", [](double value) { config.maxTurrets = (u32)value; }},
+    {"turretPlaceCooldown", [](double value) { config.turretPlaceCooldown = (float)value; }},
+    {"turretRange", [](double value) { config.turretRange = (float)value; }},
+    {"timePerAsteroidSpawn", [](double value) { config.timePerAsteroidSpawn = (float)value; }},
+    {"timeToRemovePerAsteroidSpawn", [](double value) { config.timeToRemovePerAsteroidSpawn = (float)value; }},
+    {"scorePerAsteroid", [](double value) { config.scorePerAsteroid = (u32)value; }},
+    {"initialAsteroidStage", [](double value) { config.initialAsteroidStage = (u32)value; }},
+    {"maxAsteroids", [](double value) { config.maxAsteroids = (u32)value; }},
+    {"tickBudgetMs", [](double value) { config.tickBudgetMs = (float)value; }},
+};
+
+// the window size the game usually hosts with, the map is the window
+constexpr sf::Vector2u batchMapSize = {1280, 720};
+
+// a match the bot survives this long is cut off and written as it stands
+constexpr double batchMaxMatchSeconds = 60.0 * 60.0;
+
+struct Override {
+    std::string name;
+    double value;
+};
+
+struct BatchOptions {
+    u32 matches;
+    u32 seed;
+    std::vector<Override> overrides;
+};
+
+// Returns false and names the argument when it is not name=value with a known name
+bool parseOverrides(int argc, char* argv[], int first, std::vector<Override>& overrides) {
+    for (int i = first; i < argc; i++) {
+        std::string argument = argv[i];
+        size_t equals = argument.find('=');
+        std::string name = argument.substr(0, equals);
+
+        if (equals == std::string::npos || configOverrides.find(name) == configOverrides.end()) {
+            std::fprintf(stderr, "Unknown override %s\n", argv[i]);
+            return false;
+        }
+
+        overrides.push_back({name, std::strtod(argument.c_str() + equals + 1, nullptr)});
+    }
+
+    return true;
+}
+
+// the same reset PlayState::onLeave does, the player included since every
+// match starts with a new one
+void resetMatch(flecs::world& world) {
+    clearScenario(world);
+    getContactStream(world).clear();
+
+    world.set([](SharedLivesComponent& lives){ lives.lives = config.initialLives; });
+    world.set([](ScoreComponent& score){ score.resetScore(); });
+    world.set([](AsteroidTimerComponent& timer){ timer.resetTime = config.timePerAsteroidSpawn; });
+}
+
+flecs::entity spawnBotPlayer(sf::Vector2u mapSize) {
+    return ae::getNetworkStateManager().entity()
+        .is_a<prefabs::Player>()
+        .set([&](ae::TransformComponent& transform) { transform.setPos(sf::Vector2f(mapSize) / 2.0f); })
+        .set(createPlayerPolygon);
+}
+
+// Plays one match to the end, when every player is dead, or to the time limit.
+// The world is a HeadlessMatch, so isAllPlayersDead leaves the end to this.
+void playMatch(flecs::world& world, u32 match, u32 seed, float deltaTime, const char* outputPath) {
+    std::srand(seed);
+    resetMatch(world);
+    flecs::entity player = spawnBotPlayer(batchMapSize);
+
+    MatchStats& stats = getMatchStats(world);
+    TimerWheel& wheel = getTimerWheel(world);
+    stats.begin(wheel.now());
+
+    u64 maxTicks = (u64)(batchMaxMatchSeconds / (double)deltaTime);
+    for (u64 tick = 0; tick < maxTicks; tick++) {
+        auto input = getBotInput(player);
+        player.set([&](PlayerComponent& playerComponent) {
+            playerComponent.setKeys(input.first);
+            playerComponent.setMouse(input.second);
+        });
+
+        world.progress(deltaTime);
+
+        if (isMatchOver(world))
+            break;
+    }
+
+    // the match column counts across every job, not only this one
+    stats.matchesPlayed = match;
+    stats.write(wheel.now(), world.get<ScoreComponent>()->getScore(), outputPath);
+}
+
+// Plays every jobs-th match starting at job, returns the exit code
+int runJob(const BatchOptions& options, u32 job, u32 jobs, const char* outputPath) {
+    flecs::world& world = ae::getEntityWorld();
+    bool loaded = setupHostWorld(world, batchMapSize, [&]() {
+        for (const Override& entry : options.overrides)
+            configOverrides.at(entry.name)(entry.value);
+    });
+
+    if (!loaded) {
+        std::fprintf(stderr, "Failed to load resources\n");
+        return 1;
+    }
+
+    world.add<HeadlessMatch>();
+    world.import<HostPlayStateModule>();
+    world.import<PlayStateModule>();
+
+    float deltaTime = 1.0f / (float)ae::getConfigValue<double>("tps");
+    Stopwatch stopwatch;
+    for (u32 match = job; match < options.matches; match += jobs) {
+        playMatch(world, match, options.seed + match, deltaTime, outputPath);
+        std::printf("job %u: match %u/%u done, %.1fs elapsed\n", job, match + 1, options.matches, stopwatch.getSeconds());
+    }
+
+    return 0;
+}
+
+std::string getPartPath(const char* outputPath, u32 job) {
+    return ae::formatString("%s.part%u", outputPath, job);
+}
+
+// Appends the rows of every part to the output ordered by match, and removes
+// the parts. The header is written only when the output is still empty.
+bool mergeParts(const char* outputPath, u32 jobs) {
+    std::string header;
+    std::vector<std::pair<u32, std::string>> rows;
+    for (u32 job = 0; job < jobs; job++) {
+        std::string partPath = getPartPath(outputPath, job);
+        std::ifstream part(partPath);
+        std::string line;
+        if (std::getline(part, line))
+            header = line;
+
+        while (std::getline(part, line))
+            rows.push_back({(u32)std::strtoul(line.c_str(), nullptr, 10), line});
+
+        part.close();
+        std::remove(partPath.c_str());
+    }
+
+    std::sort(rows.begin(), rows.end());
+
+    std::ifstream existing(outputPath);
+    bool writeHeader = !existing.good() || existing.peek() == std::ifstream::traits_type::eof();
+    existing.close();
+
+    std::ofstream output(outputPath, std::ios::app);
+    if (!output.is_open())
+        return false;
+
+    if (writeHeader && !header.empty())
+        output << header << '\n';
+    for (const auto& row : rows)
+        output << row.second << '\n';
+
+    return true;
+}
+
+// Forks one process per job and waits for all of them, returns the exit code
+int runJobs(const BatchOptions& options, u32 jobs, const char* outputPath) {
+#if defined(__unix__) || defined(__APPLE__)
+    if (jobs > 1) {
+        std::fflush(stdout);
+
+        std::vector<pid_t> children;
+        for (u32 job = 0; job < jobs; job++) {
+            pid_t pid = fork();
+            if (pid == 0) {
+                std::string partPath = getPartPath(outputPath, job);
+                std::remove(partPath.c_str());
+                std::exit(runJob(options, job, jobs, partPath.c_str()));
+            }
+
+            if (pid < 0) {
+                std::fprintf(stderr, "Failed to start job %u\n", job);
+                break;
+            }
+
+            children.push_back(pid);
+        }
+
+        bool failed = children.size() != jobs;
+        for (pid_t child : children) {
+            int status = 0;
+            waitpid(child, &status, 0);
+            failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+        }
+
+        if (!mergeParts(outputPath, (u32)children.size())) {
+            std::fprintf(stderr, "Failed to write %s\n", outputPath);
+            return 1;
+        }
+
+        return failed ? 1 : 0;
+    }
+#endif
+
+    return runJob(options, 0, 1, outputPath);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <matches> [seed] [output.csv] [jobs] [name=value ...]\n", argv[0]);
+        return 1;
+    }
+
+    BatchOptions options;
+    options.matches = getArgument(argc, argv, 1, 1);
+    options.seed = getArgument(argc, argv, 2, 1);
+    const char* outputPath = argc > 3 ? argv[3] : matchStatsPath;
+
+    u32 jobs = getArgument(argc, argv, 4, 1);
+    if (jobs == 0)
+        jobs = std::max(std::thread::hardware_concurrency(), 1u);
+    jobs = std::max(std::min(jobs, options.matches), 1u);
+
+    if (!parseOverrides(argc, argv, 5, options.overrides))
+        return 1;
+
+    Stopwatch stopwatch;
+    int result = runJobs(options, jobs, outputPath);
+    std::printf("played %u matches on %u jobs in %.1fs, results are in %s\n", options.matches, jobs, stopwatch.getSeconds(), outputPath);
+
+    return result;
+}
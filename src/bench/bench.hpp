@@ -0,0 +1,52 @@
+#pragma once
+#include "base.hpp"
+
+// Small helpers shared by the benchmark targets.
+
+struct Percentiles {
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+    double mean = 0.0;
+};
+
+inline Percentiles computePercentiles(std::vector<double> samples) {
+    Percentiles result;
+    if (samples.empty())
+        return result;
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double fraction) {
+        return samples[std::min(samples.size() - 1, (size_t)(fraction * (double)samples.size()))];
+    };
+
+    result.p50 = at(0.50);
+    result.p90 = at(0.90);
+    result.p99 = at(0.99);
+    result.max = samples.back();
+    for (double sample : samples)
+        result.mean += sample;
+    result.mean /= (double)samples.size();
+
+    return result;
+}
+
+class Stopwatch {
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    void restart() { start = std::chrono::steady_clock::now(); }
+
+    double getSeconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+// reads argv[index] as a number, or returns fallback when it was not given
+inline u32 getArgument(int argc, char* argv[], int index, u32 fallback) {
+    return index < argc ? (u32)std::strtoul(argv[index], nullptr, 10) : fallback;
+}
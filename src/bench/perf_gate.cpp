@@ -0,0 +1,221 @@
+#include "scenario.hpp"
+#include "bench.hpp"
+
+#include <regex>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+// Runs one fixed host scenario for a fixed number of ticks and compares server
+// tick time, replicated bytes per tick and peak RSS against a baseline file.
+// Exits with 1 when any metric in the baseline is worse than its value by more
+// than its tolerance, so ctest fails on a regression.
+//
+// Replicated bytes and transform updates only depend on the seeded scenario,
+// so they are the same on every machine and are always gated, a baseline
+// without them fails. Tick times and RSS depend on the machine and are only
+// gated when the baseline has them, which it should only on a dedicated
+// machine that recorded them with --update-timings.
+//
+// usage: asteroids_perf_gate <baseline.json> [results.json] [--update | --update-timings]
+//   --update writes the deterministic values into the baseline, keeping tolerances
+//   --update-timings writes every value
+
+const Scenario gateScenario = {2000, 20, 4};
+constexpr u32 gateSeed = 1;
+constexpr u32 gateWarmupTicks = 60;
+constexpr u32 gateTicks = 600;
+
+struct Metric {
+    std::string name;
+    double value = 0.0;
+    double tolerance = 0.0; // allowed growth over the baseline, 0.1 is 10%
+    bool deterministic = false;
+};
+
+// tolerances for metrics the baseline does not have yet
+const std::vector<Metric> defaultMetrics = {
+    {"tick_p50_us", 0.0, 0.5},
+    {"tick_p99_us", 0.0, 0.75},
+    {"replicated_bytes_per_tick_per_client", 0.0, 0.02, true},
+    {"transform_updates_per_tick", 0.0, 0.02, true},
+    {"peak_rss_kb", 0.0, 0.2},
+};
+
+u64 getPeakRssKb() {
+#if defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (u64)usage.ru_maxrss / 1024; // bytes on macOS
+#elif defined(__unix__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (u64)usage.ru_maxrss;
+#else
+    return 0;
+#endif
+}
+
+// the governor reacts to how fast this machine is, it would make the
+// deterministic metrics depend on it
+void configureGate() {
+    config.maxAsteroids = std::numeric_limits<u32>::max();
+    config.tickBudgetMs = std::numeric_limits<float>::max();
+    config.workerThreads = 1;
+}
+
+std::vector<Metric> runGate(flecs::world& world) {
+    std::srand(gateSeed);
+    populateScenario(gateScenario);
+
+    world.import<HostPlayStateModule>();
+    world.import<PlayStateModule>();
+
+    float deltaTime = 1.0f / (float)ae::getConfigValue<double>("tps");
+    for (u32 tick = 0; tick < gateWarmupTicks; tick++)
+        world.progress(deltaTime);
+
+    // replication is read from the game's own metrics, see GameMetrics
+    GameMetrics& metrics = getMetrics(world);
+    u64 bytesBefore = metrics.getReplicatedBytes();
+    u64 transformUpdatesBefore = metrics.transformUpdates.get();
+
+    std::vector<double> tickTimes;
+    tickTimes.reserve(gateTicks);
+    for (u32 tick = 0; tick < gateTicks; tick++) {
+        Stopwatch stopwatch;
+        world.progress(deltaTime);
+        tickTimes.push_back(stopwatch.getSeconds() * 1e6);
+    }
+
+    Percentiles percentiles = computePercentiles(tickTimes);
+    return {
+        {"tick_p50_us", percentiles.p50},
+        {"tick_p99_us", percentiles.p99},
+        {"replicated_bytes_per_tick_per_client", (double)(metrics.getReplicatedBytes() - bytesBefore) / (double)gateTicks, 0.0, true},
+        {"transform_updates_per_tick", (double)(metrics.transformUpdates.get() - transformUpdatesBefore) / (double)gateTicks, 0.0, true},
+        {"peak_rss_kb", (double)getPeakRssKb()},
+    };
+}
+
+// Reads the flat {"name": {"value": x, "tolerance": y}, ...} files this writes
+std::vector<Metric> readMetrics(const char* path) {
+    std::ifstream file(path);
+    if (!file)
+        return {};
+
+    std::stringstream contents;
+    contents << file.rdbuf();
+    std::string text = contents.str();
+
+    const std::regex entry(R"re("(\w+)"\s*:\s*\{\s*"value"\s*:\s*([-+0-9.eE]+)\s*,\s*"tolerance"\s*:\s*([-+0-9.eE]+)\s*\})re");
+    std::vector<Metric> metrics;
+    for (auto it = std::sregex_iterator(text.begin(), text.end(), entry); it != std::sregex_iterator(); ++it)
+        metrics.push_back({(*it)[1].str(), std::stod((*it)[2].str()), std::stod((*it)[3].str())});
+
+    return metrics;
+}
+
+bool writeMetrics(const char* path, const std::vector<Metric>& metrics) {
+    FILE* file = std::fopen(path, "w");
+    if (file == nullptr)
+        return false;
+
+    std::fprintf(file, "{\n");
+    for (size_t i = 0; i < metrics.size(); i++) {
+        std::fprintf(file, "  \"%s\": {\"value\": %.3f, \"tolerance\": %.3f}%s\n",
+            metrics[i].name.c_str(), metrics[i].value, metrics[i].tolerance, i + 1 < metrics.size() ? "," : "");
+    }
+    std::fprintf(file, "}\n");
+    std::fclose(file);
+
+    return true;
+}
+
+const Metric* findMetric(const std::vector<Metric>& metrics, const std::string& name) {
+    for (const Metric& metric : metrics) {
+        if (metric.name == name)
+            return &metric;
+    }
+
+    return nullptr;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <baseline.json> [results.json] [--update | --update-timings]\n", argv[0]);
+        return 1;
+    }
+
+    const char* baselinePath = argv[1];
+    const char* resultsPath = argc > 2 ? argv[2] : "perf_results.json";
+    bool updateTimings = argc > 3 && std::strcmp(argv[3], "--update-timings") == 0;
+    bool update = updateTimings || (argc > 3 && std::strcmp(argv[3], "--update") == 0);
+
+    flecs::world& world = ae::getEntityWorld();
+    if (!setupHostWorld(world, benchMapSize, configureGate)) {
+        std::fprintf(stderr, "Failed to load resources\n");
+        return 1;
+    }
+
+    std::vector<Metric> baseline = readMetrics(baselinePath);
+    std::vector<Metric> results = runGate(world);
+    for (Metric& result : results) {
+        const Metric* base = findMetric(baseline, result.name);
+        result.tolerance = base != nullptr ? base->tolerance : findMetric(defaultMetrics, result.name)->tolerance;
+    }
+
+    if (!writeMetrics(resultsPath, results))
+        std::fprintf(stderr, "Failed to write %s\n", resultsPath);
+
+    if (update) {
+        // timings recorded on another machine are kept as they are
+        std::vector<Metric> updated;
+        for (const Metric& result : results) {
+            const Metric* base = findMetric(baseline, result.name);
+            if (result.deterministic || updateTimings)
+                updated.push_back(result);
+            else if (base != nullptr)
+                updated.push_back(*base);
+        }
+
+        if (!writeMetrics(baselinePath, updated)) {
+            std::fprintf(stderr, "Failed to write %s\n", baselinePath);
+            return 1;
+        }
+
+        std::printf("baseline %s updated\n", baselinePath);
+        return 0;
+    }
+
+    std::printf("asteroids: %u, turrets: %u, players: %u, ticks: %u\n",
+        gateScenario.asteroids, gateScenario.turrets, gateScenario.players, gateTicks);
+
+    bool regressed = false;
+    bool missingBaseline = false;
+    for (const Metric& result : results) {
+        const Metric* base = findMetric(baseline, result.name);
+        if (base == nullptr) {
+            std::printf("  %-40s %12.3f %s\n", result.name.c_str(), result.value,
+                result.deterministic ? "NO BASELINE" : "(not gated on this machine)");
+            missingBaseline |= result.deterministic;
+            continue;
+        }
+
+        double limit = base->value * (1.0 + base->tolerance);
+        bool failed = result.value > limit;
+        regressed |= failed;
+
+        std::printf("  %-40s %12.3f baseline %12.3f limit %12.3f %s\n",
+            result.name.c_str(), result.value, base->value, limit, failed ? "REGRESSED" : "ok");
+    }
+
+    if (missingBaseline)
+        std::printf("record a baseline with: %s %s %s --update\n", argv[0], baselinePath, resultsPath);
+
+    return regressed || missingBaseline ? 1 : 0;
+}
@@ -0,0 +1,92 @@
+#include "render.hpp"
+#include "global.hpp"
+#include "bench.hpp"
+
+// Renders a synthetic scene into an offscreen sf::RenderTexture with the same
+// SceneRenderer the game draws with, so it runs without a display (for example
+// on Mesa's software GL) and reports frame time percentiles and draw calls.
+//
+// usage: asteroids_render_bench [asteroids] [bullets] [turrets] [frames]
+
+constexpr sf::Vector2u benchTargetSize = {1280, 720};
+
+int main(int argc, char* argv[]) {
+    u32 asteroidCount = getArgument(argc, argv, 1, 2000);
+    u32 bulletCount = getArgument(argc, argv, 2, 500);
+    u32 turretCount = getArgument(argc, argv, 3, 50);
+    u32 frameCount = getArgument(argc, argv, 4, 600);
+
+    sf::RenderTexture texture;
+    if (!texture.create(benchTargetSize)) {
+        std::fprintf(stderr, "Failed to create a %ux%u render texture\n", benchTargetSize.x, benchTargetSize.y);
+        return 1;
+    }
+
+    flecs::world& world = ae::getEntityWorld();
+    world.import<TickArenaModule>(); // the shapes are generated into the world's arena
+    ae::PhysicsWorld& physicsWorld = ae::getPhysicsWorld();
+    std::srand(1);
+
+    auto randomPos = []() {
+        return sf::Vector2f(randomFloat() * (float)benchTargetSize.x, randomFloat() * (float)benchTargetSize.y);
+    };
+
+    for (u32 i = 0; i < asteroidCount; i++) {
+        getTickArena(world).reset();
+
+        sf::Vector2f pos = randomPos();
+        TickVector<sf::Vector2f> vertices = generateRandomConvexShape(world, 8, 2.0f + randomFloat() * 6.0f);
+
+        world.entity().set([&](ae::ShapeComponent& shape, ae::TransformComponent& transform, ColorComponent& color) {
+            transform.setPos(pos);
+            transform.setRot(0.0f);
+            color.setColor(sf::Color::White);
+
+            shape.shape = physicsWorld.createShape<ae::Polygon>();
+            ae::Polygon& polygon = physicsWorld.getPolygon(shape.shape);
+            polygon.setVertices((u8)vertices.size(), vertices.data());
+            polygon.setPos(pos);
+        });
+    }
+
+    for (u32 i = 0; i < bulletCount; i++) {
+        world.entity().set([&](BulletComponent& bullet, ae::TransformComponent& transform, ColorComponent& color) {
+            transform.setPos(randomPos());
+            color.setColor(sf::Color::Yellow);
+        });
+    }
+
+    for (u32 i = 0; i < turretCount; i++) {
+        world.entity().set([&](TurretComponent& turret, ae::TransformComponent& transform) {
+            transform.setPos(randomPos());
+        });
+    }
+
+    SceneRenderer renderer(world);
+    std::vector<double> frameTimes;
+    frameTimes.reserve(frameCount);
+    u64 drawCalls = 0;
+
+    flecs::query<ae::TransformComponent> transforms = world.query<ae::TransformComponent>();
+    for (u32 frame = 0; frame < frameCount; frame++) {
+        // keeps every mesh moving so no frame can skip transform work
+        transforms.each([](ae::TransformComponent& transform) {
+            transform.setRot(transform.getRot() + 0.01f);
+        });
+
+        Stopwatch stopwatch;
+        renderer.capture(physicsWorld);
+        texture.clear(sf::Color::Black);
+        drawCalls += renderer.draw(texture, false, 0.5f);
+        texture.display();
+        frameTimes.push_back(stopwatch.getSeconds() * 1000.0);
+    }
+
+    Percentiles percentiles = computePercentiles(frameTimes);
+    std::printf("asteroids: %u, bullets: %u, turrets: %u, frames: %u\n", asteroidCount, bulletCount, turretCount, frameCount);
+    std::printf("frame ms: p50 %.3f p90 %.3f p99 %.3f max %.3f mean %.3f\n",
+        percentiles.p50, percentiles.p90, percentiles.p99, percentiles.max, percentiles.mean);
+    std::printf("draw calls per frame: %.2f\n", frameCount == 0 ? 0.0 : (double)drawCalls / (double)frameCount);
+
+    return 0;
+}
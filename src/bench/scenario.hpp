@@ -0,0 +1,79 @@
+#pragma once
+#include "game.hpp"
+
+// Synthetic host worlds shared by the headless benchmarks. Everything is drawn
+// from std::rand, so seeding it first makes a scenario the same on every run.
+
+struct Scenario {
+    u32 asteroids;
+    u32 turrets;
+    u32 players;
+};
+
+constexpr sf::Vector2u benchMapSize = {4000, 4000};
+
+inline sf::Vector2f randomMapPos() {
+    return sf::Vector2f(randomFloat() * (float)benchMapSize.x, randomFloat() * (float)benchMapSize.y);
+}
+
+// Sets the world up the way the game does when it starts hosting, minus the
+// window and the network interface. Returns false when resources failed to load.
+// configure runs after the config file is applied and before anything reads it,
+// without one the asteroid cap is lifted so benchmarks can build any scenario.
+inline bool setupHostWorld(flecs::world& world, sf::Vector2u mapSize = benchMapSize, const std::function<void()>& configure = nullptr) {
+    world.import<ProfileModule>();
+
+    ae::setConfigApplyCallback(applyGameConfig);
+    ae::applyConfig();
+    if (configure)
+        configure();
+    else
+        config.maxAsteroids = std::numeric_limits<u32>::max();
+
+    global = std::make_shared<Global>();
+    if (!global->loadResources())
+        return false;
+
+    registerNetworkedComponents();
+    registerPrefabs(world);
+    createHostSingletons(world, mapSize);
+
+    return true;
+}
+
+inline void populateScenario(const Scenario& scenario) {
+    TickVector<AsteroidSpawn> spawns = makeTickVector<AsteroidSpawn>(ae::getEntityWorld());
+    for (u32 i = 0; i < scenario.asteroids; i++) {
+        sf::Vector2f velocity = sf::Vector2f(randomFloat() - 0.5f, randomFloat() - 0.5f) * 20.0f;
+        spawns.push_back({randomMapPos(), velocity, (u8)config.initialAsteroidStage});
+    }
+    spawnAsteroids(ae::getEntityWorld(), spawns);
+    getTickArena(ae::getEntityWorld()).reset();
+
+    for (u32 i = 0; i < scenario.turrets; i++) {
+        ae::getNetworkStateManager().entity()
+            .is_a<prefabs::Turret>()
+            .set([&](ae::TransformComponent& transform) { transform.setPos(randomMapPos()); });
+    }
+
+    for (u32 i = 0; i < scenario.players; i++) {
+        ae::getNetworkStateManager().entity()
+            .is_a<prefabs::Player>()
+            .set(createPlayerPolygon)
+            .set([&](PlayerComponent& player, ae::TransformComponent& transform) {
+                transform.setPos(randomMapPos());
+                player.setKeys(InputFlagBits::UP | InputFlagBits::LEFT);
+                player.setMouse(randomMapPos());
+            });
+    }
+}
+
+inline void clearScenario(flecs::world& world) {
+    world.delete_with(flecs::IsA, world.id<prefabs::Asteroid>());
+    world.delete_with(flecs::IsA, world.id<prefabs::Bullet>());
+    world.delete_with(flecs::IsA, world.id<prefabs::Turret>());
+    world.delete_with(flecs::IsA, world.id<prefabs::Player>());
+    getAsteroidPool(world).parked.clear();
+    getBulletPool(world).parked.clear();
+    getAggregateIndex(world).clearAsteroids();
+}
@@ -0,0 +1,209 @@
+#include "game.hpp"
+#include "bench.hpp"
+
+// Measures what every networked component, and the networked components of
+// every prefab, costs on the wire: bytes per item, serialize and deserialize
+// ns per item and heap allocations per message. Items are written in batches
+// into one ae::MessageBuffer through ae::startSerialize and read back through
+// ae::Deserializer, the same calls the game sends messages with, so nothing
+// goes through a socket.
+//
+// usage: asteroids_serialize_bench [output.json] [messages] [batch]
+
+// every allocation made by the process, so the bench can tell how many a
+// message costs
+std::atomic<u64> allocationCount = 0;
+
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+
+// A fixed set of components, written and read back in the same order
+struct Payload {
+    std::string name;
+    std::function<void(ae::Serializer&)> write;
+    std::function<void(ae::Deserializer&)> read;
+};
+
+template<typename... Components>
+Payload makePayload(std::string name, Components... components) {
+    std::shared_ptr<std::tuple<Components...>> values = std::make_shared<std::tuple<Components...>>(components...);
+
+    return {
+        std::move(name),
+        [values](ae::Serializer& ser) {
+            std::apply([&](auto&... component) { (ser.object(component), ...); }, *values);
+        },
+        [](ae::Deserializer& des) {
+            std::tuple<Components...> out;
+            std::apply([&](auto&... component) { (des.object(component), ...); }, out);
+        }
+    };
+}
+
+struct PayloadResult {
+    std::string name;
+    double bytes;        // per item
+    double serializeNs;  // per item
+    double deserializeNs;
+    double serializeAllocations; // per message
+    double deserializeAllocations;
+};
+
+PayloadResult measure(const Payload& payload, u32 messages, u32 batch) {
+    PayloadResult result;
+    result.name = payload.name;
+
+    ae::MessageBuffer buffer;
+    std::vector<double> samples;
+    samples.reserve(messages);
+
+    u64 allocations = allocationCount;
+    for (u32 message = 0; message < messages; message++) {
+        Stopwatch stopwatch;
+        buffer = ae::MessageBuffer();
+        ae::Serializer ser = ae::startSerialize(buffer);
+        for (u32 i = 0; i < batch; i++)
+            payload.write(ser);
+        ae::endSerialize(ser, buffer);
+        samples.push_back(stopwatch.getSeconds() * 1e9 / (double)batch);
+    }
+    result.serializeAllocations = (double)(allocationCount - allocations) / (double)messages;
+    result.serializeNs = computePercentiles(samples).p50;
+    result.bytes = (double)buffer.size() / (double)batch;
+
+    samples.clear();
+    allocations = allocationCount;
+    for (u32 message = 0; message < messages; message++) {
+        Stopwatch stopwatch;
+        ae::Deserializer des(buffer.begin(), buffer.size());
+        for (u32 i = 0; i < batch; i++)
+            payload.read(des);
+        samples.push_back(stopwatch.getSeconds() * 1e9 / (double)batch);
+    }
+    result.deserializeAllocations = (double)(allocationCount - allocations) / (double)messages;
+    result.deserializeNs = computePercentiles(samples).p50;
+
+    return result;
+}
+
+// values a running match would send, not defaults, so nothing compresses
+// better here than it does in the game
+struct Samples {
+    HealthComponent health;
+    ColorComponent color = ColorComponent(sf::Color(200, 30, 30));
+    PlayerColorComponent playerColor;
+    PlayerComponent player;
+    AsteroidComponent asteroid;
+    BulletComponent bullet;
+    SharedLivesComponent lives;
+    ScoreComponent score;
+    MapSizeComponent mapSize;
+    TurretComponent turret;
+
+    Samples() {
+        health.setHealth(0.75f);
+        playerColor.setColor(sf::Color(30, 200, 30));
+        player.setKeys(InputFlagBits::UP | InputFlagBits::FIRE);
+        player.setMouse({640.5f, 360.25f});
+        player.setIsReady(true);
+        asteroid.stage = 3;
+        bullet.velocity = {28.3f, -28.3f};
+        score.addScore(1230);
+        mapSize.setSize(sf::Vector2u(1280, 720));
+    }
+};
+
+std::vector<Payload> componentPayloads(const Samples& s) {
+    return {
+        makePayload("SharedLivesComponent", s.lives),
+        makePayload("ScoreComponent", s.score),
+        makePayload("HealthComponent", s.health),
+        makePayload("ColorComponent", s.color),
+        makePayload("PlayerColorComponent", s.playerColor),
+        makePayload("PlayerComponent", s.player),
+        makePayload("AsteroidComponent", s.asteroid),
+        makePayload("BulletComponent", s.bullet),
+        makePayload("MapSizeComponent", s.mapSize),
+        makePayload("TurretComponent", s.turret),
+    };
+}
+
+// The engine replicates a component whole whenever it is modified, so a full
+// update of an entity is every networked component of its prefab and a delta
+// is the ones the host modifies on a typical tick. Engine components such as
+// transforms are serialized inside the engine and are not counted here.
+std::vector<Payload> prefabPayloads(const Samples& s) {
+    return {
+        makePayload("Player.full", s.player, s.health, s.playerColor, s.color),
+        makePayload("Player.delta", s.player, s.health),
+        makePayload("Asteroid.full", s.asteroid, s.health, s.color),
+        makePayload("Asteroid.delta", s.health),
+        makePayload("Bullet.full", s.bullet, s.color),
+        makePayload("Turret.full", s.turret),
+    };
+}
+
+void printResults(const char* title, const std::vector<PayloadResult>& results) {
+    std::printf("%s\n", title);
+    for (const PayloadResult& result : results) {
+        std::printf("  %-24s %6.2f B %8.2f ns ser %8.2f ns des %6.2f allocs/msg ser %6.2f allocs/msg des\n",
+            result.name.c_str(), result.bytes, result.serializeNs, result.deserializeNs,
+            result.serializeAllocations, result.deserializeAllocations);
+    }
+}
+
+void writeJsonGroup(FILE* file, const char* key, const std::vector<PayloadResult>& results, bool last) {
+    std::fprintf(file, "  \"%s\": {\n", key);
+    for (size_t i = 0; i < results.size(); i++) {
+        const PayloadResult& result = results[i];
+        std::fprintf(file, "    \"%s\": {\"bytes\": %.3f, \"serialize_ns\": %.3f, \"deserialize_ns\": %.3f, \"serialize_allocs\": %.3f, \"deserialize_allocs\": %.3f}%s\n",
+            result.name.c_str(), result.bytes, result.serializeNs, result.deserializeNs,
+            result.serializeAllocations, result.deserializeAllocations, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  }%s\n", last ? "" : ",");
+}
+
+int main(int argc, char* argv[]) {
+    const char* outputPath = argc > 1 ? argv[1] : "serialize_results.json";
+    u32 messages = std::max(getArgument(argc, argv, 2, 1000), 1u);
+    u32 batch = std::max(getArgument(argc, argv, 3, 256), 1u);
+
+    // component defaults read the config
+    ae::setConfigApplyCallback(applyGameConfig);
+    ae::applyConfig();
+
+    Samples samples;
+    std::vector<PayloadResult> components;
+    for (const Payload& payload : componentPayloads(samples))
+        components.push_back(measure(payload, messages, batch));
+
+    std::vector<PayloadResult> prefabs;
+    for (const Payload& payload : prefabPayloads(samples))
+        prefabs.push_back(measure(payload, messages, batch));
+
+    std::printf("messages: %u, items per message: %u\n", messages, batch);
+    printResults("components", components);
+    printResults("prefabs", prefabs);
+
+    FILE* file = std::fopen(outputPath, "w");
+    if (file == nullptr) {
+        std::fprintf(stderr, "Failed to open %s\n", outputPath);
+        return 1;
+    }
+
+    std::fprintf(file, "{\n  \"messages\": %u,\n  \"batch\": %u,\n", messages, batch);
+    writeJsonGroup(file, "components", components, false);
+    writeJsonGroup(file, "prefabs", prefabs, true);
+    std::fprintf(file, "}\n");
+    std::fclose(file);
+
+    return 0;
+}
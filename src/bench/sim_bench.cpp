@@ -0,0 +1,185 @@
+#include "scenario.hpp"
+#include "bench.hpp"
+
+// Builds synthetic host worlds at scale and times the host systems one at a
+// time, then a full world.progress(), without a window or a network. Results
+// are printed and written as JSON, times are per run of the system and
+// ns/entity divides the median by the number of entities the system touches.
+//
+// usage: asteroids_bench [output.json] [runs]
+//    or: asteroids_bench [output.json] [runs] [asteroids] [turrets] [players]
+
+const std::vector<Scenario> defaultScenarios = {
+    {1000, 0, 1},
+    {10000, 100, 8},
+    {100000, 500, 64},
+};
+
+constexpr float benchDeltaTime = 1.0f / 60.0f;
+
+struct SystemResult {
+    std::string name;
+    u32 entities;
+    Percentiles micros;
+};
+
+// runs before every timed run, outside of the timing
+using Prepare = std::function<void()>;
+
+SystemResult timeSystem(const char* name, flecs::system system, u32 entities, u32 runs, Prepare prepare = nullptr) {
+    std::vector<double> samples;
+    samples.reserve(runs);
+
+    for (u32 run = 0; run < runs; run++) {
+        if (prepare)
+            prepare();
+
+        Stopwatch stopwatch;
+        system.run(benchDeltaTime);
+        samples.push_back(stopwatch.getSeconds() * 1e6);
+        getTickArena(system.world()).reset();
+    }
+
+    return {name, entities, computePercentiles(samples)};
+}
+
+std::vector<SystemResult> runScenario(flecs::world& world, const Scenario& scenario, u32 runs) {
+    std::srand(1);
+    populateScenario(scenario);
+
+    std::vector<SystemResult> results;
+    AggregateIndex& index = getAggregateIndex(world);
+    u32 transforms = (u32)world.count<ae::TransformComponent>();
+
+    results.push_back(timeSystem("transformWrap",
+        world.system<MapSizeComponent, ae::TransformComponent>().term_at(1).singleton().kind(0).iter(transformWrap),
+        transforms, runs));
+
+    results.push_back(timeSystem("turretPlayUpdate",
+        world.system<ae::TransformComponent, TurretComponent>().kind(0).iter(turretPlayUpdate),
+        index.turrets, runs));
+
+    results.push_back(timeSystem("playerPlayInputUpdate",
+        world.system<PlayerComponent, ae::IntegratableComponent, ae::TransformComponent, HealthComponent>().kind(0).iter(playerPlayInputUpdate),
+        index.players, runs));
+
+    // every run destroys a hundredth of the asteroids so the time includes
+    // releasing them. They are stage 1 asteroids spawned from the pool right
+    // before the run, so none split and the population is the same every run.
+    u32 toDestroy = std::max(index.asteroids / 100, 1u);
+    flecs::query<AsteroidComponent, HealthComponent> asteroidHealths = world.query<AsteroidComponent, HealthComponent>();
+    results.push_back(timeSystem("asteroidDestroyUpdate",
+        world.system<AsteroidComponent, ae::TransformComponent, ae::IntegratableComponent, HealthComponent>().kind(0).iter(asteroidDestroyUpdate),
+        index.asteroids + toDestroy, runs, [&]() {
+            TickVector<AsteroidSpawn> spawns = makeTickVector<AsteroidSpawn>(world);
+            for (u32 i = 0; i < toDestroy; i++)
+                spawns.push_back({randomMapPos(), sf::Vector2f(), 1});
+            spawnAsteroids(world, spawns);
+
+            u32 left = toDestroy;
+            asteroidHealths.each([&](AsteroidComponent& asteroid, HealthComponent& health) {
+                if (left == 0 || asteroid.stage != 1 || health.isDestroyed())
+                    return;
+
+                health.setDestroyed(true);
+                left--;
+            });
+        }));
+
+    // bullets fired at random through the field, so the sweep has hits to find
+    u32 bulletCount = std::max(scenario.asteroids / 10, 1u);
+    for (u32 i = 0; i < bulletCount; i++) {
+        ae::TransformComponent origin;
+        origin.setPos(randomMapPos());
+        spawnBullet(world, origin, sf::Vector2f(randomFloat() - 0.5f, randomFloat() - 0.5f) * config.playerBulletSpeed * 10.0f);
+    }
+
+    flecs::system sweep = world.system<ae::TransformComponent, BulletComponent>().kind(0).iter(bulletSweepUpdate);
+    results.push_back(timeSystem("bulletSweepUpdate", sweep, bulletCount, runs));
+
+    // resolves the hits of a fresh sweep every run, collision observers feed
+    // the same stream so this covers them as well
+    results.push_back(timeSystem("collisionResolveUpdate",
+        world.system().kind(0).iter(collisionResolveUpdate),
+        bulletCount, runs, [&]() { sweep.run(benchDeltaTime); }));
+
+    // a full tick with every host and play state system, plus the engine's own
+    // imported once, and enabled again for every scenario after the first
+    flecs::entity hostModule = world.import<HostPlayStateModule>().enable();
+    flecs::entity playModule = world.import<PlayStateModule>().enable();
+    std::vector<double> samples;
+    for (u32 run = 0; run < runs; run++) {
+        Stopwatch stopwatch;
+        world.progress(benchDeltaTime);
+        samples.push_back(stopwatch.getSeconds() * 1e6);
+    }
+    results.push_back({"world.progress", (u32)world.count<ae::TransformComponent>(), computePercentiles(samples)});
+
+    hostModule.disable();
+    playModule.disable();
+    clearScenario(world);
+
+    return results;
+}
+
+void printResults(const Scenario& scenario, const std::vector<SystemResult>& results) {
+    std::printf("asteroids: %u, turrets: %u, players: %u\n", scenario.asteroids, scenario.turrets, scenario.players);
+    for (const SystemResult& result : results) {
+        double nsPerEntity = result.entities == 0 ? 0.0 : result.micros.p50 * 1000.0 / (double)result.entities;
+        std::printf("  %-24s p50 %10.2fus p90 %10.2fus p99 %10.2fus %8.2f ns/entity (%u)\n",
+            result.name.c_str(), result.micros.p50, result.micros.p90, result.micros.p99, nsPerEntity, result.entities);
+    }
+}
+
+void writeJson(FILE* file, const std::vector<Scenario>& scenarios, const std::vector<std::vector<SystemResult>>& results) {
+    std::fprintf(file, "{\n  \"scenarios\": [\n");
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        const Scenario& scenario = scenarios[i];
+        std::fprintf(file, "    {\n      \"name\": \"a%u_t%u_p%u\",\n", scenario.asteroids, scenario.turrets, scenario.players);
+        std::fprintf(file, "      \"asteroids\": %u,\n      \"turrets\": %u,\n      \"players\": %u,\n", scenario.asteroids, scenario.turrets, scenario.players);
+        std::fprintf(file, "      \"systems\": {\n");
+
+        for (size_t j = 0; j < results[i].size(); j++) {
+            const SystemResult& result = results[i][j];
+            double nsPerEntity = result.entities == 0 ? 0.0 : result.micros.p50 * 1000.0 / (double)result.entities;
+            std::fprintf(file, "        \"%s\": {\"entities\": %u, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, \"mean_us\": %.3f, \"ns_per_entity\": %.3f}%s\n",
+                result.name.c_str(), result.entities, result.micros.p50, result.micros.p90, result.micros.p99, result.micros.max, result.micros.mean,
+                nsPerEntity, j + 1 < results[i].size() ? "," : "");
+        }
+
+        std::fprintf(file, "      }\n    }%s\n", i + 1 < scenarios.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* outputPath = argc > 1 ? argv[1] : "bench_results.json";
+    u32 runs = getArgument(argc, argv, 2, 100);
+
+    std::vector<Scenario> scenarios = defaultScenarios;
+    if (argc > 5)
+        scenarios = {{getArgument(argc, argv, 3, 0), getArgument(argc, argv, 4, 0), getArgument(argc, argv, 5, 1)}};
+
+    flecs::world& world = ae::getEntityWorld();
+    if (!setupHostWorld(world)) {
+        std::fprintf(stderr, "Failed to load resources\n");
+        return 1;
+    }
+
+    std::vector<std::vector<SystemResult>> results;
+    for (const Scenario& scenario : scenarios) {
+        results.push_back(runScenario(world, scenario, runs));
+        printResults(scenario, results.back());
+    }
+
+    FILE* file = std::fopen(outputPath, "w");
+    if (file == nullptr) {
+        std::fprintf(stderr, "Failed to open %s\n", outputPath);
+        return 1;
+    }
+
+    writeJson(file, scenarios, results);
+    std::fclose(file);
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "component.hpp"
+#include "arena.hpp"
+
+constexpr float botSightRange = 400.0f;
+constexpr float botFleeDistance = 120.0f;
+
+// Scripted stand-in for getInput() used by autoplay. The bot is always ready,
+// shoots the closest asteroid it can see and backs away from it once it gets
+// close, drifts back to the middle of the map when nothing is in sight, and
+// places a turret whenever the score allows it.
+inline std::pair<u8, sf::Vector2f> getBotInput(flecs::entity player) {
+    std::pair<u8, sf::Vector2f> input;
+    input.first = InputFlagBits::READY | InputFlagBits::PLACE_TURRET;
+    input.second = {};
+
+    const ae::TransformComponent* transform = player.get<ae::TransformComponent>();
+    if (transform == nullptr)
+        return input;
+
+    ae::PhysicsWorld& physicsWorld = ae::getPhysicsWorld();
+    sf::Vector2f pos = transform->getPos();
+    ae::AABB aabb(botSightRange, botSightRange, pos);
+
+    TickVector<ae::SpatialIndexElement> results = makeTickVector<ae::SpatialIndexElement>(player.world());
+    physicsWorld.getTree().query(spatial::intersects<2>(aabb.min.data(), aabb.max.data()), std::back_inserter(results));
+
+    sf::Vector2f closestPos;
+    float smallestDistance = std::numeric_limits<float>::max();
+    for (ae::SpatialIndexElement& element : results) {
+        if ((element.collisionMask & AsteroidCollisionMask) == 0)
+            continue;
+
+        flecs::entity other = ae::impl::af(element.entityId);
+        if (!other.is_valid() || !other.enabled())
+            continue;
+
+        sf::Vector2f otherPos = physicsWorld.getShape(element.shapeId).getWeightedPos();
+        float distance = (pos - otherPos).length();
+        if (distance < smallestDistance) {
+            closestPos = otherPos;
+            smallestDistance = distance;
+        }
+    }
+
+    if (smallestDistance == std::numeric_limits<float>::max()) {
+        sf::Vector2f center = player.world().get<MapSizeComponent>()->getSize() / 2.0f;
+
+        input.second = center;
+        if ((center - pos).length() > botFleeDistance)
+            input.first |= InputFlagBits::UP;
+
+        return input;
+    }
+
+    input.second = closestPos;
+    input.first |= InputFlagBits::FIRE;
+    if (smallestDistance < botFleeDistance)
+        input.first |= InputFlagBits::DOWN;
+
+    return input;
+}
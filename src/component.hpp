@@ -1,5 +1,6 @@
 #pragma once
 #include "base.hpp"
+#include "timer.hpp"
 
 struct HealthComponent : public ae::NetworkedComponent {
 public:
@@ -54,6 +55,18 @@ private:
 
 struct HostPlayerComponent {};
 
+// Added to the world while it simulates as the host, by createHostSingletons,
+// so host only rules do not depend on which network interface is running
+struct HostAuthority {};
+
+// Added to the world by the batch runner, which ends its matches itself since
+// there are no states to move between
+struct HeadlessMatch {};
+
+// kept on players so AggregateIndex can count them without polling
+struct PlayerReady {};
+struct PlayerDead {};
+
 struct PlayerComponent : public ae::NetworkedComponent {
 public:
     bool isUpPressed() { return keys & InputFlagBits::UP; }
@@ -67,23 +80,23 @@ public:
     sf::Vector2f getMouse() { return mouse; }
     void setMouse(sf::Vector2f mouse) { this->mouse = mouse; }
 
-    float getLastFired() { return lastFired; }
-    float getLastBlink() { return lastBlink; }
-    float getTimeTillRevive() { return timeTillRevive; }
-    float getTurretPlaceCooldown() { return turretCooldown; }
-
-    void resetLastFired() { lastFired = 0.0f; }
-    void resetLastBlink() { lastBlink = config.blinkResetTime; }
-    void resetTimeTillRevive() { timeTillRevive = config.reviveImmunityTime; }
-    void resetTurretPlaceCooldown() { turretCooldown = config.turretPlaceCooldown; }
-
-    void addTimer(float deltaTime, bool isDead) {
-        lastBlink -= deltaTime;
-        lastFired += deltaTime;
-        turretCooldown -= deltaTime;
-        if(isDead)
-            timeTillRevive -= deltaTime;
+    // timers are deadlines on the TimerWheel clock, nothing counts down per tick
+    bool canFire(double now) { return now >= fireReadyAt; }
+    bool isBlinking(double now) { return now >= blinkAt; }
+    bool isBlinkOver(double now) { return now >= blinkAt + 0.5; }
+    bool canRevive(double now) { return reviveAt >= 0.0 && now >= reviveAt; }
+    bool canPlaceTurret(double now) { return now >= turretReadyAt; }
+
+    void resetLastFired(double now) { fireReadyAt = now + config.playerFireRate; }
+    void resetLastBlink(double now) { blinkAt = now + config.blinkResetTime; }
+    void resetTurretPlaceCooldown(double now) { turretReadyAt = now + config.turretPlaceCooldown; }
+
+    // the revive countdown only runs while dead, so it starts when death is first seen
+    void startReviveTimer(double now) {
+        if(reviveAt < 0.0)
+            reviveAt = now + config.reviveImmunityTime;
     }
+    void resetTimeTillRevive() { reviveAt = -1.0; }
 
     void setIsFiring(bool fire) { isFiring_ = fire; }
     bool isFiring() { return isFiring_; }
@@ -103,10 +116,10 @@ private:
 	sf::Vector2f mouse;
 	bool ready = false;
 	bool isFiring_ = false;
-	float timeTillRevive = 5.0f;
-	float lastBlink = 0.0f;
-	float lastFired = 0.0f;
-    float turretCooldown = 0.0f;
+	double reviveAt = -1.0;
+	double blinkAt = 0.0;
+	double fireReadyAt = 0.0;
+    double turretReadyAt = 0.0;
 
 };
 
@@ -119,12 +132,17 @@ struct AsteroidComponent : public ae::NetworkedComponent {
     }
 };
 
+// bullets are not physics shapes, they move along velocity and are swept
+// against the spatial index every tick on the host
 struct BulletComponent : public ae::NetworkedComponent {
     float damage = 10.0f;
+    sf::Vector2f velocity;
+    TimerWheel::Handle expiryTimer = 0; // host only
 
     template<typename S>
     void serialize(S& s) {
         s.value4b(damage);
+        s.object(velocity);
     }
 };
 
@@ -158,7 +176,7 @@ struct MapSizeComponent : public ae::NetworkedComponent {
 public:
     void setSize(float newWidth, float newHeight) { this->width = newWidth; this->height = newHeight; }
     void setSize(sf::Vector2u s) { this->width = (float)s.x; this->height = (float)s.y; }
-    sf::Vector2f getSize() { return {width, height}; }
+    sf::Vector2f getSize() const { return {width, height}; }
     float getWidth() { return width; }
     float getHeight() { return height; }
 
@@ -176,19 +194,15 @@ private:
  
 struct TurretComponent : public ae::NetworkedComponent {
 public:
-    void addTimer(float deltaTime) {
-        lastFired -= deltaTime;
-    }
-
-    float getLastFired() { return lastFired; }
-    void resetLastFired() { lastFired = config.playerFireRate; }
+    bool canFire(double now) { return now >= fireReadyAt; }
+    void resetLastFired(double now) { fireReadyAt = now + config.playerFireRate; }
 
 
     template<typename S>
     void serialize(S& s) {}
 
 private:
-    float lastFired = 0.0f;
+    double fireReadyAt = 0.0;
 };
 
 struct AsteroidTimerComponent {
@@ -196,6 +210,11 @@ struct AsteroidTimerComponent {
     float current = config.timePerAsteroidSpawn;
 };
 
+// owned by the world so every system shares one wheel, see getTimerWheel()
+struct TimerWheelComponent {
+    std::shared_ptr<TimerWheel> wheel;
+};
+
 namespace prefabs {
     struct Player {};
     struct Asteroid {};
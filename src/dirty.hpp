@@ -0,0 +1,71 @@
+#pragma once
+#include "base.hpp"
+
+// Entities whose replicated components changed since the last flush, one set
+// per component. Host systems mark() changed entities instead of calling
+// modified<>() on them, and flush() calls modified<>() once for every marked
+// entity, which is what the network state manager replicates. It is flushed
+// once a frame, right before the engine sends, so an entity marked by several
+// systems or in several fixed steps of one frame is replicated once, and marking
+// it again costs a bit test.
+//
+// The bits are indexed by the entity index, the low 32 bits of its id, so they
+// survive the entity moving between tables. Only safe to mark from the main
+// thread, which every system that marks runs on.
+template<typename... Components>
+class DirtySet {
+public:
+    template<typename T>
+    void mark(flecs::entity entity) {
+        Set& set = sets[indexOf<T, Components...>()];
+        u32 index = (u32)entity.id();
+        size_t word = index / 64;
+        u64 bit = (u64)1 << (index % 64);
+
+        if (set.bits.size() <= word)
+            set.bits.resize(word + 1, 0);
+        if (set.bits[word] & bit)
+            return;
+
+        set.bits[word] |= bit;
+        set.marked.push_back(entity.id());
+    }
+
+    void flush(const flecs::world& world) {
+        (flushComponent<Components>(world), ...);
+    }
+
+private:
+    template<typename T, typename First, typename... Rest>
+    static constexpr size_t indexOf() {
+        if constexpr (std::is_same_v<T, First>)
+            return 0;
+        else
+            return 1 + indexOf<T, Rest...>();
+    }
+
+    template<typename T>
+    void flushComponent(const flecs::world& world) {
+        Set& set = sets[indexOf<T, Components...>()];
+
+        for (flecs::entity_t id : set.marked) {
+            u32 index = (u32)id;
+            set.bits[index / 64] &= ~((u64)1 << (index % 64));
+
+            // an entity destroyed after it was marked has nothing left to send
+            flecs::entity entity(world, id);
+            if (entity.is_alive())
+                entity.modified<T>();
+        }
+
+        set.marked.clear();
+    }
+
+    struct Set {
+        std::vector<u64> bits;
+        std::vector<flecs::entity_t> marked; // in the order they were marked
+    };
+
+private:
+    std::array<Set, sizeof...(Components)> sets;
+};
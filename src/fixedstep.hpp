@@ -0,0 +1,110 @@
+#pragma once
+#include "base.hpp"
+
+// never simulate more than this many steps in one frame, so one slow frame
+// does not make the next one slower until the game stalls
+constexpr u32 maxStepsPerFrame = 5;
+
+// Where a system runs within a fixed step, lower runs first. Systems with the
+// same order run in the order they were added.
+enum FixedStepOrder: u32 {
+    FIXED_STEP_BEGIN,      // tick bracketing, the governor starts timing
+    FIXED_STEP_COLLISIONS, // hits found and resolved
+    FIXED_STEP_TIMERS,     // timers due this step fire
+    FIXED_STEP_UPDATE,     // game rules, spawns and input
+    FIXED_STEP_MOVE,       // movement the engine does not integrate
+    FIXED_STEP_END         // tick bracketing, the governor stops timing
+};
+
+struct FixedStepSystem {
+    u32 order;
+    flecs::system system;
+};
+
+// Frame time is collected into an accumulator at the start of every frame and
+// paid out in steps of a fixed length, 1 / tps. Systems that depend on time or
+// act once per tick are added with addFixedStepSystems and run once per step,
+// so the simulation advances the same way no matter how fast frames come in.
+struct FixedStepComponent {
+    float step = 0.0f;
+    float accumulator = 0.0f;
+    u32 steps = 0;     // steps due this frame
+    float alpha = 0.0f; // how far into the next step the frame is, for rendering
+    std::vector<FixedStepSystem> systems; // sorted by order
+
+    // time the fixed step systems advance by this frame
+    float getElapsed() const { return (float)steps * step; }
+};
+
+inline const FixedStepComponent& getFixedStep(const flecs::world& world) {
+    return *world.get<FixedStepComponent>();
+}
+
+inline void fixedStepBegin(flecs::iter& iter, FixedStepComponent* fixed) {
+    fixed->accumulator += iter.delta_time();
+    fixed->steps = (u32)(fixed->accumulator / fixed->step);
+
+    if (fixed->steps > maxStepsPerFrame) {
+        fixed->steps = maxStepsPerFrame;
+        fixed->accumulator = 0.0f;
+    }
+    else {
+        fixed->accumulator -= fixed->getElapsed();
+    }
+
+    fixed->alpha = fixed->accumulator / fixed->step;
+}
+
+// a system is skipped while it or the module it was created in is disabled,
+// which is how state modules are switched off
+inline bool isSystemEnabled(flecs::entity system) {
+    for (flecs::entity e = system; e.is_valid(); e = e.parent()) {
+        if (!e.enabled())
+            return false;
+    }
+
+    return true;
+}
+
+// Runs every enabled fixed step system in order, once for every step due this
+// frame, so the systems of all modules interleave step by step. It is
+// no_readonly, so the steps run on the world itself instead of a readonly
+// stage, and the commands each step queued are merged before the next one,
+// which then sees the entities the last step spawned and destroyed.
+inline void fixedStepDriver(flecs::iter& iter, FixedStepComponent* fixed) {
+    flecs::world world = iter.world();
+
+    for (u32 step = 0; step < fixed->steps; step++) {
+        for (const FixedStepSystem& entry : fixed->systems) {
+            if (isSystemEnabled(entry.system))
+                entry.system.run(fixed->step);
+        }
+
+        world.defer_end();
+        world.defer_begin();
+    }
+}
+
+// Adds systems to the fixed step at order, in the order given. The systems must
+// be created without a phase, .kind(0), so the pipeline does not run them a
+// second time, and inside the module they belong to.
+inline void addFixedStepSystems(flecs::world& world, FixedStepOrder order, std::vector<flecs::system> systems) {
+    std::vector<FixedStepSystem>& list = world.get_mut<FixedStepComponent>()->systems;
+    for (const flecs::system& system : systems)
+        list.push_back({order, system});
+
+    std::stable_sort(list.begin(), list.end(), [](const FixedStepSystem& a, const FixedStepSystem& b) {
+        return a.order < b.order;
+    });
+}
+
+struct FixedStepModule {
+    FixedStepModule(flecs::world& world) {
+        world.set([](FixedStepComponent& fixed) {
+            fixed.step = 1.0f / (float)ae::getConfigValue<double>("tps");
+        });
+
+        world.system<FixedStepComponent>().term_at(1).singleton().kind(flecs::OnLoad).iter(fixedStepBegin);
+        world.system<FixedStepComponent>().term_at(1).singleton().kind(flecs::OnUpdate).no_readonly().iter(fixedStepDriver);
+    }
+};
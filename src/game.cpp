@@ -2,10 +2,6 @@
 
 // ============= START STATE =============
 
-struct {
-    int readyCount = 0;
-} internalReadyContext;
-
 void updatePlayerReady(flecs::iter& iter, PlayerComponent* players, ColorComponent* colors, PlayerColorComponent* playerColors) {
     for (auto i : iter) {
         flecs::entity entity = iter.entity(i);
@@ -13,11 +9,11 @@ void updatePlayerReady(flecs::iter& iter, PlayerComponent* players, ColorCompone
         if (players[i].isReadyPressed() || players[i].isReady()) {
             if(!players[i].isReady()) {// avoid making player marked 'dirty'
                 players[i].setIsReady(true);
+                entity.add<PlayerReady>();
                 entity.modified<PlayerComponent>();
             }
 
             colors[i].setColor(playerColors[i].getColor());
-            internalReadyContext.readyCount++;
 
             entity.modified<ColorComponent>();
         }
@@ -25,32 +21,29 @@ void updatePlayerReady(flecs::iter& iter, PlayerComponent* players, ColorCompone
 }
 
 void isAllPlayersReady(flecs::iter& iter) {
-    if (internalReadyContext.readyCount == (int)iter.world().count<PlayerComponent>()) {
-        internalReadyContext.readyCount = 0;
+    AggregateIndex& index = getAggregateIndex(iter.world());
+
+    if (index.readyPlayers == index.players) {
         ae::transitionState<PlayState>();
-    } else {
-        internalReadyContext.readyCount = 0;
     }
 }
 
-struct {
-    float curAngle = 0.0f;
-} internalOrientContext;
-
-float PI = 3.14159265359f;
+constexpr float PI = 3.14159265359f;
 
 void orientPlayers(flecs::iter& iter, ae::TransformComponent* transforms) {
+    PROFILE_FUNCTION();
+    OrientContextComponent* orient = iter.world().get_mut<OrientContextComponent>();
     sf::Vector2f middle = (sf::Vector2f)ae::getWindow().getSize() / 2.0f;
 
     float radii = 50.0f;
-    float anglePerTurn = 2.0f * PI / iter.world().count<PlayerComponent>();
+    float anglePerTurn = 2.0f * PI / getAggregateIndex(iter.world()).players;
 
-    internalOrientContext.curAngle += iter.delta_time();
+    orient->curAngle += iter.delta_time();
 
-    for(int i = 0; i < iter.count(); i++, internalOrientContext.curAngle += anglePerTurn) {
+    for(int i = 0; i < iter.count(); i++, orient->curAngle += anglePerTurn) {
         sf::Vector2f location = {
-            ae::fastCos(internalOrientContext.curAngle),
-            ae::fastSin(internalOrientContext.curAngle),
+            ae::fastCos(orient->curAngle),
+            ae::fastSin(orient->curAngle),
         };
 
         location = location * radii + middle;
@@ -64,49 +57,93 @@ void orientPlayers(flecs::iter& iter, ae::TransformComponent* transforms) {
 
 // ============= PLAY STATE =============
 
-inline struct InternalDeadCount {
-    int deadCount = 0;
-} internalDeadCount;
-
-void updatePlayerDead(flecs::iter& iter, HealthComponent* health) {
-    for(auto i : iter) {
-        if(health[i].isDestroyed()) {
-            internalDeadCount.deadCount++;
-        }
-    }
+bool isMatchOver(const flecs::world& world) {
+    AggregateIndex& index = getAggregateIndex(world);
+    return index.deadPlayers == index.players;
 }
 
 void isAllPlayersDead(flecs::iter& iter) {
-    if(internalDeadCount.deadCount == iter.world().count<PlayerComponent>()) {
-        internalDeadCount.deadCount = 0;
+    if (iter.world().has<HeadlessMatch>())
+        return;
+
+    if(isMatchOver(iter.world())) {
         ae::transitionState<GameOverState>();
-    } else {
-        internalDeadCount.deadCount = 0;
     }
 }
 
 void isDead(flecs::iter& iter, HealthComponent* healths) {
+    PROFILE_FUNCTION();
     for (auto i : iter) {
-        flecs::entity entity = iter.entity(i);
-
         if (healths[i].getHealth() <= 0.0f) {
+            flecs::entity entity = iter.entity(i);
+            if (!healths[i].isDestroyed() && entity.has<PlayerComponent>())
+                entity.add<PlayerDead>();
+
             healths[i].setDestroyed(true);
             entity.modified<HealthComponent>();
         }
     }
 }
 
+void releaseBullet(flecs::entity bullet) {
+    getTimerWheel(bullet.world()).cancel(bullet.get<BulletComponent>()->expiryTimer);
+    getBulletPool(bullet.world()).release(bullet);
+}
+
+void expireBullet(flecs::entity bullet) {
+    if (bullet.is_alive())
+        getBulletPool(bullet.world()).release(bullet);
+}
+
+// Disabling a parked asteroid hides it from systems but not from the physics
+// world, its polygon stays in the spatial index. So the polygon is moved far
+// outside of the map, each one to its own spot so parked asteroids never
+// overlap each other, and stops colliding until it is spawned again.
+//
+// Only the polygon moves. The transform is replicated, so it keeps the spot
+// the asteroid died at and clients never see the jump, spawnAsteroids sets
+// both again when the asteroid is reused.
+void releaseAsteroid(flecs::entity asteroid) {
+    EntityPool& pool = getAsteroidPool(asteroid.world());
+    sf::Vector2f parkedPos = {-100000.0f - 1000.0f * (float)pool.parked.size(), -100000.0f};
+    pool.release(asteroid);
+
+    ae::Polygon& polygon = ae::getPhysicsWorld().getPolygon(asteroid.get<ae::ShapeComponent>()->shape);
+    polygon.setPos(parkedPos);
+    polygon.setCollisonMask(0);
+}
+
+void spawnBullet(flecs::world world, const ae::TransformComponent& origin, sf::Vector2f velocity) {
+    flecs::entity bullet = getBulletPool(world).acquire(world);
+    bool reused = bullet.is_valid();
+    if (!reused)
+        bullet = ae::getNetworkStateManager().entity().is_a<prefabs::Bullet>();
+
+    TimerWheel::Handle expiryTimer = getTimerWheel(world).schedule(bulletLifetime, bullet, expireBullet);
+    bullet.set([&](ae::TransformComponent& bulletTransform, BulletComponent& bulletComponent) {
+        bulletTransform = origin;
+        bulletComponent.velocity = velocity;
+        bulletComponent.expiryTimer = expiryTimer;
+    });
+
+    if (reused)
+        ae::getNetworkStateManager().enable(bullet);
+
+    getMatchStats(world).bulletsFired++;
+    getMetrics(world).bulletsFired.add();
+}
+
 void playerPlayInputUpdate(flecs::iter& iter, PlayerComponent* players, ae::IntegratableComponent* integratables, ae::TransformComponent* transforms, HealthComponent* healths) {
-    float deltaTime = iter.delta_time();
+    PROFILE_FUNCTION();
+    double now = getTimerWheel(iter.world()).now();
     ScoreComponent* score = iter.world().get_mut<ScoreComponent>();
+    ReplicationDirty& replication = getReplicationDirty(iter.world());
 
     for (auto i : iter) {
         PlayerComponent& player = players[i];
         ae::IntegratableComponent& integratable = integratables[i];
         ae::TransformComponent& transform = transforms[i];
 
-        player.addTimer(deltaTime, healths[i].isDestroyed());
-
         sf::Vector2f backwards = (transform.getPos() - player.getMouse()).normalized();
         sf::Vector2f left = backwards.perpendicular();
 
@@ -115,61 +152,51 @@ void playerPlayInputUpdate(flecs::iter& iter, PlayerComponent* players, ae::Inte
 
         if (player.isUpPressed()) {
             integratable.addLinearVelocity(-backwards * config.playerSpeed);
-               iter.entity(i).modified<ae::IntegratableComponent>();
+            replication.mark<ae::IntegratableComponent>(iter.entity(i));
         }
         if (player.isDownPressed()) {
             integratable.addLinearVelocity(backwards * config.playerSpeed);
-            iter.entity(i).modified<ae::IntegratableComponent>();
+            replication.mark<ae::IntegratableComponent>(iter.entity(i));
         }
         if (player.isLeftPressed()) {
             integratable.addLinearVelocity(left * config.playerSpeed * 0.5f);
-            iter.entity(i).modified<ae::IntegratableComponent>();
+            replication.mark<ae::IntegratableComponent>(iter.entity(i));
         }
         if (player.isRightPressed()) {
             integratable.addLinearVelocity(-left * config.playerSpeed * 0.5f);
-            iter.entity(i).modified<ae::IntegratableComponent>();
+            replication.mark<ae::IntegratableComponent>(iter.entity(i));
         }
 
          // make sure to only place turrets down and fire host side
-        if(ae::getNetworkManager().hasNetworkInterface<ServerInterface>()) {
+        if(iter.world().has<HostAuthority>()) {
             if (player.isTurretPlacePressed() &&  // IS IT PLACE BUTTON PRESSED?
-                player.getTurretPlaceCooldown() <= 0.0f &&  // IS THE PLACE COOLDOWN DOWN?
-                iter.world().count<TurretComponent>() + 1 <= config.maxTurrets && // DOES PLACING ONE MORE SURPASS maxTurrets?
+                player.canPlaceTurret(now) &&  // IS THE PLACE COOLDOWN DOWN?
+                getAggregateIndex(iter.world()).turrets + 1 <= config.maxTurrets && // DOES PLACING ONE MORE SURPASS maxTurrets?
                 (score->getScore() - config.turretPrice >= 0)) {
 
                 score->removeScore(config.turretPrice);
-                player.resetTurretPlaceCooldown();
+                player.resetTurretPlaceCooldown(now);
                 ae::getNetworkStateManager().entity()
                     .is_a<prefabs::Turret>()
                     .set([&](ae::TransformComponent& turretTranform) {
                         turretTranform.setPos(transform.getPos());
                     });
 
-                iter.entity(i).modified<PlayerComponent>();
+                getMatchStats(iter.world()).turretsPlaced++;
+                getMetrics(iter.world()).turretsPlaced.add();
+                replication.mark<PlayerComponent>(iter.entity(i));
                 iter.world().modified<ScoreComponent>();
             }
 
-            if (player.isFirePressed() && player.getLastFired() > config.playerFireRate) {
-                player.resetLastFired();
+            if (player.isFirePressed() && player.canFire(now)) {
+                player.resetLastFired(now);
                 player.setIsFiring(true);
 
-                ae::getNetworkStateManager().entity()
-                    .is_a<prefabs::Bullet>()
-                    .set([&](ae::TransformComponent& bulletTransform, ae::IntegratableComponent& integratable, ae::ShapeComponent& shape) {
-                        ae::PhysicsWorld& world = ae::getPhysicsWorld();
-
-                        bulletTransform = transform;
-
-                        sf::Vector2f velocityDir = (player.getMouse() - transform.getPos()).normalized() * config.playerBulletSpeed;
-                        integratable.addLinearVelocity(velocityDir);
-                        integratables[i].addLinearVelocity(-velocityDir * config.playerBulletRecoilMultiplier);
+                sf::Vector2f velocityDir = (player.getMouse() - transform.getPos()).normalized() * config.playerBulletSpeed;
+                integratable.addLinearVelocity(-velocityDir * config.playerBulletRecoilMultiplier);
+                spawnBullet(iter.world(), transform, velocityDir);
 
-                        shape.shape = world.createShape<ae::Circle>(5.0f);
-
-                        world.getCircle(shape.shape).setCollisonMask(PlayerCollisionMask);
-                    }).add<BulletComponent>();
-
-                iter.entity(i).modified<PlayerComponent>();
+                replication.mark<PlayerComponent>(iter.entity(i));
             } else {
                 player.setIsFiring(false);
             }
@@ -178,17 +205,20 @@ void playerPlayInputUpdate(flecs::iter& iter, PlayerComponent* players, ae::Inte
 }
 
 void playerBlinkUpdate(flecs::iter& iter, PlayerComponent* players, HealthComponent* healths, ColorComponent* colors, PlayerColorComponent* playerColors) {
+    PROFILE_FUNCTION();
+    double now = getTimerWheel(iter.world()).now();
+
     for (auto i : iter) {
         PlayerComponent& player = players[i];
         HealthComponent& health = healths[i];
         ColorComponent& color = colors[i];
         PlayerColorComponent& playerColor = playerColors[i];
 
-        if (player.getLastBlink() <= 0.0f && health.isDestroyed()) {
+        if (player.isBlinking(now) && health.isDestroyed()) {
             color.setColor(sf::Color::Blue);
 
-            if(player.getLastBlink() <= -0.5f) {
-                player.resetLastBlink();
+            if(player.isBlinkOver(now)) {
+                player.resetLastBlink(now);
             }
 
             iter.entity(i).modified<ColorComponent>();
@@ -200,19 +230,25 @@ void playerBlinkUpdate(flecs::iter& iter, PlayerComponent* players, HealthCompon
 }
 
 void playerReviveUpdate(flecs::iter& iter, SharedLivesComponent* lives, PlayerComponent* players, HealthComponent* healths) {
+    PROFILE_FUNCTION();
+    double now = getTimerWheel(iter.world()).now();
+    u32 livesBefore = lives->lives;
+
     for (auto i : iter) {
         PlayerComponent& player = players[i];
         HealthComponent& health = healths[i];
 
         if (health.isDestroyed()) {
+            player.startReviveTimer(now);
+
             if(lives->lives > 0) {
-                if (player.getTimeTillRevive() <= 0.0f) {
+                if (player.canRevive(now)) {
                     player.resetTimeTillRevive();
                     health.setDestroyed(false);
                     health.setHealth(1.0f);
 
                     lives->lives--;
-                    iter.world().modified<SharedLivesComponent>();
+                    iter.entity(i).remove<PlayerDead>();
                     iter.entity(i).modified<HealthComponent>();
                 }
             } else {
@@ -220,161 +256,216 @@ void playerReviveUpdate(flecs::iter& iter, SharedLivesComponent* lives, PlayerCo
             }
         } 
     }
+
+    if (lives->lives != livesBefore)
+        iter.world().modified<SharedLivesComponent>();
 }
 
-void createChildAsteroids(flecs::world world, ae::TransformComponent& parentTransform, ae::IntegratableComponent& parentIntegratable, u8 parentStage) {
+void spawnAsteroids(flecs::world world, const TickVector<AsteroidSpawn>& spawns) {
+    PROFILE_FUNCTION();
     ae::PhysicsWorld& physicsWorld = ae::getPhysicsWorld();
+    AggregateIndex& index = getAggregateIndex(world);
+    EntityPool& pool = getAsteroidPool(world);
+
+    // keeps the commands for every new asteroid queued until the end, so each
+    // one is moved into its final table once instead of once per component
+    world.defer_begin();
+    for (const AsteroidSpawn& spawn : spawns) {
+        flecs::entity entity = pool.acquire(world);
+        bool reused = entity.is_valid();
+        if (!reused)
+            entity = ae::getNetworkStateManager().entity().is_a<prefabs::Asteroid>();
+
+        entity.set([&](AsteroidComponent& asteroid,
+                       ae::ShapeComponent& shape,
+                       ae::TransformComponent& transform,
+                       ae::IntegratableComponent& integratable,
+                       HealthComponent& health) {
+            transform.setPos(spawn.pos);
+            transform.setRot(0.0f);
+            integratable.addLinearVelocity(spawn.velocity - integratable.getLinearVelocity());
+            asteroid.stage = spawn.stage;
+            health.setHealth(1.0f);
+            health.setDestroyed(false);
+
+            // a parked asteroid keeps its polygon, only the vertices are replaced
+            if (!reused)
+                shape.shape = physicsWorld.createShape<ae::Polygon>();
+            ae::Polygon& polygon = physicsWorld.getPolygon(shape.shape);
+            polygon.setRot(0.0f);
 
-    sf::Vector2f linearVelocity = parentIntegratable.getLinearVelocity() * config.asteroidDestroySpeedMultiplier;
+            TickVector<sf::Vector2f> vertices = generateRandomConvexShape(world, 8, ((float)spawn.stage / (float)config.initialAsteroidStage) * config.asteroidScalar);
+            polygon.setVertices((u8)vertices.size(), vertices.data());
+            polygon.setPos(transform.getPos());
+            polygon.setCollisonMask(AsteroidCollisionMask);
+        });
 
-    for(u32 i = 0; i < 2; i++) {
-        ae::getNetworkStateManager().entity()
-            .is_a<prefabs::Asteroid>()
-            .set([&](AsteroidComponent& asteroid, 
-                     ae::ShapeComponent& shape, 
-                     ae::TransformComponent& transform, 
-                     ae::IntegratableComponent& integratable) {
-                transform.setPos(parentTransform.getPos());
+        if (reused)
+            ae::getNetworkStateManager().enable(entity);
 
-                integratable.addLinearVelocity(linearVelocity);
-                linearVelocity *= -1.0f;
+        index.addAsteroid(spawn.stage);
+    }
+    world.defer_end();
 
-                shape.shape = physicsWorld.createShape<ae::Polygon>();
-                ae::Polygon& polygon = physicsWorld.getPolygon(shape.shape);
+    getMetrics(world).asteroidsSpawned.add(spawns.size());
+}
 
-                asteroid.stage = parentStage - 1;
+void addChildAsteroids(TickVector<AsteroidSpawn>& spawns, ae::TransformComponent& parentTransform, ae::IntegratableComponent& parentIntegratable, u8 parentStage) {
+    sf::Vector2f linearVelocity = parentIntegratable.getLinearVelocity() * config.asteroidDestroySpeedMultiplier;
 
-                std::vector<sf::Vector2f> vertices = generateRandomConvexShape(8, ((float)asteroid.stage / (float)config.initialAsteroidStage) * config.asteroidScalar);
-                polygon.setVertices((u8)vertices.size(), vertices.data());
-                polygon.setPos(transform.getPos());
-                polygon.setCollisonMask(AsteroidCollisionMask);
-            });
+    for(u32 i = 0; i < 2; i++) {
+        spawns.push_back({parentTransform.getPos(), linearVelocity, (u8)(parentStage - 1)});
+        linearVelocity *= -1.0f;
     }
 }
 
 void asteroidDestroyUpdate(flecs::iter& iter, AsteroidComponent* asteroids, ae::TransformComponent* transforms, ae::IntegratableComponent* integratables, HealthComponent* healths) {
+    PROFILE_FUNCTION();
+    TickVector<AsteroidSpawn> children = makeTickVector<AsteroidSpawn>(iter.world());
+
     for (auto i : iter) {
         HealthComponent& health = healths[i];
         AsteroidComponent& asteroid = asteroids[i];
 
         if (health.isDestroyed()) {
-            iter.entity(i).destruct();
+            releaseAsteroid(iter.entity(i));
+            getAggregateIndex(iter.world()).removeAsteroid(asteroid.stage);
+            getMatchStats(iter.world()).asteroidsDestroyed++;
+            getMetrics(iter.world()).asteroidsDestroyed.add();
 
             if(asteroid.stage > 1) {
-                createChildAsteroids(iter.world(), transforms[i], integratables[i], asteroid.stage);
+                addChildAsteroids(children, transforms[i], integratables[i], asteroid.stage);
             }
         }
     }
+
+    if (!children.empty())
+        spawnAsteroids(iter.world(), children);
 }
 
-sf::Vector2f wrap(MapSizeComponent* size, sf::Vector2f pos) {
-    if (pos.x >= size->getWidth()) {
-        pos.x = 0.0f;
-    }
-    else if (pos.x <= 0.0f) {
-        pos.x = size->getWidth();
+void transformWrap(flecs::iter& iter, MapSizeComponent* size, ae::TransformComponent* transforms) {
+    PROFILE_FUNCTION();
+
+    // positions are gathered into SoA batches so the wrap runs as a SIMD kernel,
+    // only the positions it reports as moved are written back
+    ReplicationDirty& replication = getReplicationDirty(iter.world());
+    float xs[kernelBatchSize];
+    float ys[kernelBatchSize];
+    for (size_t offset = 0; offset < iter.count(); offset += kernelBatchSize) {
+        u32 count = (u32)std::min<size_t>(kernelBatchSize, iter.count() - offset);
+
+        for (u32 i = 0; i < count; i++) {
+            sf::Vector2f pos = transforms[offset + i].getPos();
+            xs[i] = pos.x;
+            ys[i] = pos.y;
+        }
+
+        u64 moved = wrapPositions(xs, ys, count, size->getWidth(), size->getHeight());
+        for (u32 i = 0; moved != 0; i++, moved >>= 1) {
+            if (moved & 1) {
+                transforms[offset + i].setPos({xs[i], ys[i]});
+                replication.mark<ae::TransformComponent>(iter.entity(offset + i));
+            }
+        }
     }
+}
 
-    if (pos.y >= size->getHeight()) {
-        pos.y = 0.0f;
+sf::Vector2f getAsteroidSpawnPos(MapSizeComponent* mapSize) {
+    float spawnX = (randomFloat() * mapSize->getWidth());
+    float spawnY = (randomFloat() * mapSize->getHeight());
+
+    float wallX = 0.0f;
+    float distX = 0.0f;
+    float distToLeft = spawnX;
+    float distToRight = mapSize->getWidth() - spawnX;
+    if (distToLeft < distToRight) {
+        wallX = mapSize->getWidth() - 0.01f;
+        distX = distToRight;
     }
-    else if (pos.y <= 0.0f) {
-        pos.y = size->getHeight();
+    else {
+        distX = distToLeft;
     }
 
-    return pos;
-}
-
-void transformWrap(flecs::iter& iter, MapSizeComponent* size, ae::TransformComponent* transforms) {
-    for (auto i : iter) {
-        ae::TransformComponent& transform = transforms[i];
-        sf::Vector2f pos = wrap(size, transform.getPos());
+    float wallY = 0.0f;
+    float distY = 0.0f;
+    float distToUp = spawnY;
+    float distToDown = mapSize->getHeight() - spawnY;
+    if (distToUp < distToDown) {
+        wallY = mapSize->getHeight() - 0.1f;
+        distY = distToDown;
+    }
+    else {
+        distY = distToUp;
+    }
 
-        if (pos != transform.getPos()) {
-            transform.setPos(pos);
-            iter.entity(i).modified<ae::TransformComponent>();   
-        }
+    if (distX < distY) {
+        spawnX = wallX;
     }
+    else {
+        spawnY = wallY;
+    }
+
+    return {spawnX, spawnY};
 }
 
 void asteroidAddUpdate(flecs::iter& iter, MapSizeComponent* mapSize, AsteroidTimerComponent* timer) {
-    ae::PhysicsWorld& physicsWorld = ae::getPhysicsWorld();
-
-    if(iter.world().count<AsteroidComponent>() > config.maxAsteroids)
+    PROFILE_FUNCTION();
+    size_t asteroidCount = getAggregateIndex(iter.world()).asteroids;
+    if(asteroidCount > config.maxAsteroids)
         return;
 
+    // once the spawn interval is shorter than a tick several asteroids are due
+    // at once, so they are all collected and spawned together
+    TickVector<AsteroidSpawn> spawns = makeTickVector<AsteroidSpawn>(iter.world());
     timer->current -= iter.delta_time();
-    if (timer->current < 0.0f) {
-        timer->current = timer->resetTime;
-        timer->resetTime -= config.timeToRemovePerAsteroidSpawn;
-
-        float spawnX = (randomFloat() * mapSize->getWidth());
-        float spawnY = (randomFloat() * mapSize->getHeight());
-
-        float wallX = 0.0f;
-        float distX = 0.0f;
-        float distToLeft = spawnX;
-        float distToRight = mapSize->getWidth() - spawnX;
-        if (distToLeft < distToRight) {
-            wallX = mapSize->getWidth() - 0.01f;
-            distX = distToRight;
-        }
-        else {
-            distX = distToLeft;
+    OverloadGovernor& governor = getOverloadGovernor(iter.world());
+    bool capped = false;
+    while (timer->current < 0.0f && asteroidCount + spawns.size() <= config.maxAsteroids) {
+        if (!governor.takeSpawn()) {
+            capped = true;
+            break;
         }
 
-        float wallY = 0.0f;
-        float distY = 0.0f;
-        float distToUp = spawnY;
-        float distToDown = mapSize->getHeight() - spawnY;
-        if (distToUp < distToDown) {
-            wallY = mapSize->getHeight() - 0.1f;
-            distY = distToDown;
-        }
-        else {
-            distY = distToUp;
-        }
+        sf::Vector2f pos = getAsteroidSpawnPos(mapSize);
+        sf::Vector2f center = mapSize->getSize() / 2.0f;
+        sf::Vector2f velToCenter = (pos - center).normalized();
+        spawns.push_back({pos, velToCenter * 10.0f, (u8)config.initialAsteroidStage});
 
-        if (distX < distY) {
-            spawnX = wallX;
-        }
-        else {
-            spawnY = wallY;
-        }
+        timer->current += timer->resetTime;
+        timer->resetTime -= config.timeToRemovePerAsteroidSpawn;
 
-        ae::getNetworkStateManager().entity()
-            .is_a<prefabs::Asteroid>()
-            .set([&](ae::ShapeComponent& shape, ae::TransformComponent& transform, ae::IntegratableComponent& integratable) {
-                transform.setPos({ spawnX, spawnY });
+        // with no interval left one asteroid is spawned every tick
+        if (timer->resetTime <= 0.0f) {
+            timer->current = 0.0f;
+            break;
+        }
+    }
 
-                sf::Vector2f center = mapSize->getSize() / 2.0f;
-                sf::Vector2f velToCenter = (transform.getPos() - center).normalized();
-                integratable.addLinearVelocity(velToCenter * 10.0f);
+    // when the spawn cap stopped the loop the overdue time is kept to one
+    // interval, so a long overload is not followed by a burst of every asteroid
+    // it held back. Without an interval left the one per tick fallback applies.
+    if (capped && timer->resetTime > 0.0f)
+        timer->current = std::max(timer->current, -timer->resetTime);
 
-                shape.shape = physicsWorld.createShape<ae::Polygon>();
-                ae::Polygon& polygon = physicsWorld.getPolygon(shape.shape);
-
-                std::vector<sf::Vector2f> vertices = generateRandomConvexShape(8, config.asteroidScalar);
-                polygon.setVertices((u8)vertices.size(), vertices.data());
-                polygon.setPos(transform.getPos());
-                polygon.setCollisonMask(AsteroidCollisionMask);
-             });
-    }
+    if (!spawns.empty())
+        spawnAsteroids(iter.world(), spawns);
 }
 
 void turretPlayUpdate(flecs::iter& iter, ae::TransformComponent* transforms, TurretComponent* turrets) {
+    PROFILE_FUNCTION();
     ae::PhysicsWorld& physicsWorld = ae::getPhysicsWorld();
     flecs::world world = iter.world();
+    double now = getTimerWheel(iter.world()).now();
+    OverloadGovernor& governor = getOverloadGovernor(iter.world());
+    ReplicationDirty& replication = getReplicationDirty(iter.world());
     
-    std::vector<ae::SpatialIndexElement> results = {};
+    TickVector<ae::SpatialIndexElement> results = makeTickVector<ae::SpatialIndexElement>(iter.world());
     for(auto i : iter) {
-        flecs::entity entity = iter.entity(i);
         ae::TransformComponent& transform = transforms[i];
         TurretComponent& turret = turrets[i];
 
-        turret.addTimer(iter.delta_time());
         transform.setRot(transform.getRot() + 0.1f);
-        entity.modified<ae::TransformComponent>();
+        replication.mark<ae::TransformComponent>(iter.entity(i));
 
         ae::SpatialIndexTree& tree = physicsWorld.getTree();
         ae::AABB aabb(config.turretRange, config.turretRange, transform.getPos());
@@ -392,7 +483,7 @@ void turretPlayUpdate(flecs::iter& iter, ae::TransformComponent* transforms, Tur
             if((element.collisionMask & AsteroidCollisionMask) == 0)
                 continue;
 
-            if(!other.is_valid())
+            if(!other.is_valid() || !other.enabled())
                 continue;
 
             sf::Vector2f pos = physicsWorld.getShape(element.shapeId).getWeightedPos();
@@ -409,55 +500,391 @@ void turretPlayUpdate(flecs::iter& iter, ae::TransformComponent* transforms, Tur
         float angleToRotate = (closestPos - transform.getPos()).angle().asRadians();
         transform.setRot(angleToRotate);
     
-        if(turret.getLastFired() <= 0.0f) {
-            turret.resetLastFired();
+        // a turret held back by the bullet cap stays ready and fires next tick
+        if(turret.canFire(now) && governor.takeBullet()) {
+            turret.resetLastFired(now);
+
+            sf::Vector2f velocityDir = (closestPos - transform.getPos()).normalized() * config.playerBulletSpeed;
+            spawnBullet(iter.world(), transform, velocityDir);
+        }
+    }
+}
 
-            ae::getNetworkStateManager().entity()
-                .is_a<prefabs::Bullet>()
-                .set(
-                [&](ae::TransformComponent& bulletTransform, 
-                    ae::IntegratableComponent& integratable, 
-                    ae::ShapeComponent& shape) {
-                    ae::PhysicsWorld& world = ae::getPhysicsWorld();
+void observePlayerCollision(flecs::iter& iter, size_t i, ae::ShapeComponent&) {
+    // parked asteroids are disabled and must not kill anyone
+    flecs::entity other = iter.param<ae::CollisionEvent>()->entityOther;
+    if (!other.is_alive() || !other.enabled())
+        return;
 
-                    bulletTransform = transform;
+    getContactStream(iter.world()).playerHits.push_back(iter.entity(i).id());
+}
 
-                    sf::Vector2f velocityDir = (closestPos - transform.getPos()).normalized() * config.playerBulletSpeed;
-                    integratable.addLinearVelocity(velocityDir);
+// Returns the fraction of delta at which a circle of radius moving from start
+// first touches the convex polygon, or a value greater than 1 if it never does.
+// The polygon is grown by radius along its edge normals (Cyrus-Beck clipping).
+float sweepPolygon(ae::Polygon& polygon, sf::Vector2f start, sf::Vector2f delta, float radius) {
+    constexpr float miss = 2.0f;
+
+    ae::Polygon::vertices_t vertices = polygon.getWorldVertices();
+    u8 count = polygon.getVerticeCount();
+
+    sf::Vector2f center;
+    for (u8 i = 0; i < count; i++)
+        center += vertices[i];
+    center /= (float)count;
+
+    float enter = 0.0f;
+    float exit = 1.0f;
+    for (u8 i = 0; i < count; i++) {
+        sf::Vector2f a = vertices[i];
+        sf::Vector2f edge = vertices[(i + 1) % count] - a;
+        if (edge == sf::Vector2f())
+            continue;
 
-                    shape.shape = world.createShape<ae::Circle>(5.0f);
+        sf::Vector2f normal = edge.perpendicular().normalized();
+        if (normal.dot(a - center) < 0.0f)
+            normal = -normal;
 
-                    world.getCircle(shape.shape).setCollisonMask(PlayerCollisionMask);
-                }).add<BulletComponent>();
+        float distance = normal.dot(start - a) - radius; // positive when outside of this edge
+        float approach = normal.dot(delta);
+        if (approach == 0.0f) {
+            if (distance > 0.0f)
+                return miss;
+            continue;
         }
+
+        float t = -distance / approach;
+        if (approach < 0.0f)
+            enter = std::max(enter, t);
+        else
+            exit = std::min(exit, t);
+
+        if (enter > exit)
+            return miss;
     }
+
+    return enter;
 }
 
-void observePlayerCollision(flecs::iter& iter, size_t i, ae::ShapeComponent&) {
-    flecs::entity entity = iter.entity(i);
-    ae::CollisionEvent& event = *iter.param<ae::CollisionEvent>();
-    flecs::entity other = event.entityOther;
+float sweepCircle(ae::Circle& circle, sf::Vector2f start, sf::Vector2f delta, float radius) {
+    constexpr float miss = 2.0f;
 
-    if(entity.get<HealthComponent>()->isDestroyed())
-        return;
+    float combinedRadius = circle.getRadius() + radius;
+    sf::Vector2f offset = start - circle.getPos();
+    float c = offset.dot(offset) - combinedRadius * combinedRadius;
+    if (c <= 0.0f)
+        return 0.0f;
+
+    float a = delta.dot(delta);
+    float b = offset.dot(delta);
+    float discriminant = b * b - a * c;
+    if (a == 0.0f || discriminant < 0.0f)
+        return miss;
 
-    entity.set([](HealthComponent& health) { health.setHealth(0.0f); });
-    global->getNoobPlayer.play();
+    float t = (-b - std::sqrt(discriminant)) / a;
+    return t >= 0.0f ? t : miss;
 }
 
-void observeBulletCollision(flecs::iter& iter, size_t i, ae::ShapeComponent&) {
-    flecs::entity entity = iter.entity(i);
-    ae::CollisionEvent& event = *iter.param<ae::CollisionEvent>();
-    flecs::entity other = event.entityOther;
+// Bullets never enter the broadphase, instead each one is resolved as a segment
+// from its current position to where it will be at the end of this tick, hitting
+// the first asteroid along the way. This also stops fast bullets tunneling
+// through small asteroids.
+//
+// This only reads, the hits are applied by collisionResolveUpdate right after
+// it in the same fixed step. Hits go into the buffer of the running stage.
+void bulletSweepUpdate(flecs::iter& iter, ae::TransformComponent* transforms, BulletComponent* bullets) {
+    PROFILE_FUNCTION();
+    ae::PhysicsWorld& physicsWorld = ae::getPhysicsWorld();
+    ae::SpatialIndexTree& tree = physicsWorld.getTree();
+
+    // sweeps the distance bulletAdvanceUpdate moves bullets later in this step
+    float deltaTime = iter.delta_time();
+
+    std::vector<BulletHit>& hits = getContactStream(iter.world()).bulletHits[iter.world().get_stage_id()];
+
+    // workers cannot share the tick arena, each keeps its own scratch vector
+    thread_local std::vector<ae::SpatialIndexElement> results;
+    for (auto i : iter) {
+        sf::Vector2f start = transforms[i].getPos();
+        sf::Vector2f delta = bullets[i].velocity * deltaTime;
+
+        sf::Vector2f extent = {std::abs(delta.x) / 2.0f + bulletRadius, std::abs(delta.y) / 2.0f + bulletRadius};
+        ae::AABB aabb(extent.x, extent.y, start + delta / 2.0f);
+
+        results.clear();
+        tree.query(spatial::intersects<2>(aabb.min.data(), aabb.max.data()), std::back_inserter(results));
+
+        flecs::entity closest;
+        float closestTime = 1.0f;
+        for(ae::SpatialIndexElement& element : results) {
+            if((element.collisionMask & AsteroidCollisionMask) == 0)
+                continue;
+
+            flecs::entity other = ae::impl::af(element.entityId);
+            if(!other.is_valid() || !other.enabled() || !other.has<HealthComponent>())
+                continue;
+
+            ae::Shape& shape = physicsWorld.getShape(element.shapeId);
+            float time = 2.0f;
+            switch (shape.getType()) {
+            case ae::ShapeEnum::Polygon:
+                time = sweepPolygon(dynamic_cast<ae::Polygon&>(shape), start, delta, bulletRadius);
+                break;
+            case ae::ShapeEnum::Circle:
+                time = sweepCircle(dynamic_cast<ae::Circle&>(shape), start, delta, bulletRadius);
+                break;
+            }
+
+            if (time > 1.0f)
+                continue;
+
+            // ties go to the lower id so the result does not depend on tree order
+            if (!closest.is_valid() || time < closestTime || (time == closestTime && other.id() < closest.id())) {
+                closest = other;
+                closestTime = time;
+            }
+        }
+
+        if (closest.is_valid())
+            hits.push_back({iter.entity(i).id(), closest.id(), closestTime});
+    }
+}
+
+// Consumes every contact recorded since the last tick in one pass. Bullet hits
+// are applied in bullet id order, so the outcome is the same no matter how the
+// bullets were split across threads. Damage is summed per entity so each one is
+// written once, score is written once, and each sound plays at most once.
+void collisionResolveUpdate(flecs::iter& iter) {
+    PROFILE_FUNCTION();
+    flecs::world world = iter.world();
+    ContactStream& stream = getContactStream(iter.world());
+
+    std::vector<flecs::entity_t>& playerHits = stream.playerHits;
+    std::sort(playerHits.begin(), playerHits.end());
+    playerHits.erase(std::unique(playerHits.begin(), playerHits.end()), playerHits.end());
+
+    bool playerDestroyed = false;
+    for (flecs::entity_t id : playerHits) {
+        flecs::entity player(world, id);
+        if (!player.is_alive() || player.get<HealthComponent>()->isDestroyed())
+            continue;
+
+        player.set([](HealthComponent& health) { health.setHealth(0.0f); });
+        playerDestroyed = true;
+    }
+    playerHits.clear();
+
+    if (playerDestroyed)
+        global->getNoobPlayer.play();
 
-    other.set([&](HealthComponent& health) {
-        health.setHealth(health.getHealth() - entity.get<BulletComponent>()->damage);
+    TickVector<BulletHit> hits = makeTickVector<BulletHit>(iter.world());
+    for (std::vector<BulletHit>& stageHits : stream.bulletHits) {
+        hits.insert(hits.end(), stageHits.begin(), stageHits.end());
+        stageHits.clear();
+    }
+
+    std::sort(hits.begin(), hits.end(), [](const BulletHit& a, const BulletHit& b) {
+        return a.bullet < b.bullet;
     });
-    entity.destruct();
-    global->destroyPlayer.play();
 
-    if(other.has<AsteroidComponent>()) {
-        iter.world().get_mut<ScoreComponent>()->addScore(config.scorePerAsteroid);
-        iter.world().modified<ScoreComponent>();
+    TickVector<std::pair<flecs::entity_t, float>> damages = makeTickVector<std::pair<flecs::entity_t, float>>(iter.world());
+    i32 scoreGained = 0;
+    for (const BulletHit& hit : hits) {
+        flecs::entity bullet(world, hit.bullet);
+        flecs::entity other(world, hit.other);
+        if (!bullet.is_alive() || !other.is_alive())
+            continue;
+
+        damages.push_back({hit.other, bullet.get<BulletComponent>()->damage});
+        releaseBullet(bullet);
+
+        if (other.has<AsteroidComponent>())
+            scoreGained += config.scorePerAsteroid;
+    }
+
+    std::stable_sort(damages.begin(), damages.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    for (size_t i = 0; i < damages.size();) {
+        flecs::entity_t id = damages[i].first;
+        float damage = 0.0f;
+        for (; i < damages.size() && damages[i].first == id; i++)
+            damage += damages[i].second;
+
+        flecs::entity(world, id).set([&](HealthComponent& health) {
+            health.setHealth(health.getHealth() - damage);
+        });
+    }
+
+    if (!damages.empty())
+        global->destroyPlayer.play();
+
+    if (scoreGained > 0) {
+        world.get_mut<ScoreComponent>()->addScore(scoreGained);
+        world.modified<ScoreComponent>();
+    }
+}
+
+void resizeContactStream(flecs::world& world) {
+    world.get<ContactStreamComponent>()->stream->bulletHits.resize(world.get_stage_count());
+}
+
+void setWorkerThreads(flecs::world& world, u32 threads) {
+    if (threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    world.set_threads((int)threads);
+
+    // one bullet hit buffer per stage, sized here instead of every tick
+    if (world.has<ContactStreamComponent>())
+        resizeContactStream(world);
+}
+
+// runs after collisionResolveUpdate, so a bullet released by a hit has already
+// cancelled its expiry timer
+void timerWheelUpdate(flecs::iter& iter) {
+    PROFILE_FUNCTION();
+    getTimerWheel(iter.world()).advance(iter.delta_time());
+}
+
+void replicationFlush(flecs::iter& iter) {
+    PROFILE_FUNCTION();
+    getReplicationDirty(iter.world()).flush(iter.world());
+}
+
+void governorBeginTick(flecs::iter& iter) {
+    getOverloadGovernor(iter.world()).beginTick();
+}
+
+void governorEndTick(flecs::iter& iter) {
+    OverloadGovernor& governor = getOverloadGovernor(iter.world());
+    governor.endTick();
+    getMatchStats(iter.world()).recordTick(governor.getLastTickTime());
+    getMetrics(iter.world()).tickSeconds.observe(governor.getLastTickTime());
+}
+
+void bulletAdvanceUpdate(flecs::iter& iter, ae::TransformComponent* transforms, BulletComponent* bullets) {
+    PROFILE_FUNCTION();
+    float xs[kernelBatchSize];
+    float ys[kernelBatchSize];
+    float velocityXs[kernelBatchSize];
+    float velocityYs[kernelBatchSize];
+    for (size_t offset = 0; offset < iter.count(); offset += kernelBatchSize) {
+        u32 count = (u32)std::min<size_t>(kernelBatchSize, iter.count() - offset);
+
+        for (u32 i = 0; i < count; i++) {
+            sf::Vector2f pos = transforms[offset + i].getPos();
+            xs[i] = pos.x;
+            ys[i] = pos.y;
+            velocityXs[i] = bullets[offset + i].velocity.x;
+            velocityYs[i] = bullets[offset + i].velocity.y;
+        }
+
+        advancePositions(xs, ys, velocityXs, velocityYs, count, iter.delta_time());
+
+        for (u32 i = 0; i < count; i++)
+            transforms[offset + i].setPos({xs[i], ys[i]});
     }
-}
\ No newline at end of file
+}
+
+// ============= SETUP =============
+
+void applyGameConfig(ae::Config& jConfig) {
+    config.playerSpeed = (float)ae::dvalue(jConfig, "playerSpeed", 1.0);
+    config.playerFireRate = (float)ae::dvalue(jConfig, "playerFireRate", 1.0f);
+    config.playerBulletRecoilMultiplier = (float)ae::dvalue(jConfig, "playerBulletRecoilMultiplier", 0.2);
+    config.playerBulletSpeed = (float)ae::dvalue(jConfig, "playerBulletSpeed", 40.0);
+    config.playerBaseHealth = (float)ae::dvalue(jConfig, "playerBaseHealth", 1.0);
+    config.blinkResetTime = (float)ae::dvalue(jConfig, "blinkResetTime", 1.0);
+    config.reviveImmunityTime = (float)ae::dvalue(jConfig, "reviveImmunityTime", 5.0);
+    config.initialLives = (int)ae::dvalue(jConfig, "initialLives", 3);
+    config.turretPrice = (i32)ae::dvalue(jConfig, "turretPrice", 100);
+    config.maxTurrets = (u32)ae::dvalue(jConfig, "maxTurrets", 20);
+    config.turretPlaceCooldown = (float)ae::dvalue(jConfig, "turretPlaceCooldown", 1.0);
+    config.turretRange = (float)ae::dvalue(jConfig, "turretRange", 100.0);
+    config.timePerAsteroidSpawn = (float)ae::dvalue(jConfig, "timePerAsteroidSpawn", 2.0);
+    config.timeToRemovePerAsteroidSpawn = (float)ae::dvalue(jConfig, "timeToRemovePerAsteroidSpawn", 0.01);
+    config.scorePerAsteroid = (u32)ae::dvalue(jConfig, "scorePerAsteroid", 10);
+    config.initialAsteroidStage = (u32)ae::dvalue(jConfig, "initialAsteroidStage", 4);
+    config.asteroidScalar = (float)ae::dvalue(jConfig, "asteroidScalar", 8.0);
+    config.asteroidDestroySpeedMultiplier = (float)ae::dvalue(jConfig, "asteroidDestroySpeedMultiplier", 2.0);
+    config.defaultHostPort = (int)ae::dvalue(jConfig, "defaultHostPort", 9999);
+    config.inputUPS = (float)ae::dvalue(jConfig, "inputUPS", 30.0);
+    config.stateUPS = (float)ae::dvalue(jConfig, "stateUPS", 20.0);
+    config.maxAsteroids = (u32)ae::dvalue(jConfig, "maxAsteroids", 2000);
+    config.workerThreads = (u32)ae::dvalue(jConfig, "workerThreads", 1); // 0 uses every core, see setWorkerThreads
+    config.tickBudgetMs = (float)ae::dvalue(jConfig, "tickBudgetMs", 0.0); // 0 uses the tick length
+    config.governorReplicationScale = (float)ae::dvalue(jConfig, "governorReplicationScale", 0.5);
+    config.governorMaxSpawnsPerTick = (u32)ae::dvalue(jConfig, "governorMaxSpawnsPerTick", 1);
+    config.governorMaxBulletsPerTick = (u32)ae::dvalue(jConfig, "governorMaxBulletsPerTick", 16);
+    config.autoplay = ae::dvalue(jConfig, "autoplay", 0.0) != 0.0; // host plays itself with a bot
+    config.autoplayMatches = (u32)ae::dvalue(jConfig, "autoplayMatches", 0); // 0 plays forever
+    config.metricsExportInterval = (float)ae::dvalue(jConfig, "metricsExportInterval", 0.0); // seconds between writes of metrics.prom, 0 never writes
+}
+
+void registerNetworkedComponents() {
+    /* ALL NETWORKED COMPONENTS MUST BE DECLARED HERE! */
+    ae::NetworkStateManager& networkStateManager = ae::getNetworkStateManager();
+    networkStateManager.registerComponent<SharedLivesComponent>(ae::ComponentPiority::High);
+    networkStateManager.registerComponent<ScoreComponent>(ae::ComponentPiority::High);
+    networkStateManager.registerComponent<HealthComponent>();
+    networkStateManager.registerComponent<ColorComponent>(ae::ComponentPiority::High);
+    networkStateManager.registerComponent<PlayerColorComponent>(ae::ComponentPiority::High);
+    networkStateManager.registerComponent<PlayerComponent>();
+    networkStateManager.registerComponent<AsteroidComponent>();
+    networkStateManager.registerComponent<BulletComponent>();
+    networkStateManager.registerComponent<MapSizeComponent>(ae::ComponentPiority::High);
+    networkStateManager.registerComponent<TurretComponent>();
+    //networkStateManager.registerComponent<EnemyPlayerComponent>();
+}
+
+void registerPrefabs(flecs::world& world) {
+    world.prefab<prefabs::Player>()
+        .override<PlayerComponent>()
+        .override<HealthComponent>()
+        .override<ae::IntegratableComponent>()
+        .override<PlayerColorComponent>()
+        .override<ae::ShapeComponent>()
+        .set_override(ae::TransformComponent({ 300, 200 }))
+        .set_override(ColorComponent(sf::Color::Red));
+
+    world.prefab<prefabs::Turret>()
+        .override<TurretComponent>()
+        .override<ae::TransformComponent>();
+
+    world.prefab<prefabs::Asteroid>()
+        .override<AsteroidComponent>()
+        .override<ae::TransformComponent>()
+        .override<HealthComponent>()
+        .override<ae::IntegratableComponent>()
+        .set_override(ColorComponent(sf::Color::Red))
+        .override<AsteroidComponent>();
+
+    world.prefab<prefabs::Bullet>()
+        .override<ae::NetworkedEntity>()
+        .override<ae::TransformComponent>()
+        .set_override(ColorComponent(sf::Color::Yellow));
+
+    world.import<AggregateIndexModule>();
+    world.import<MetricsModule>();
+    world.import<TickArenaModule>();
+    world.import<FixedStepModule>();
+}
+
+void createHostSingletons(flecs::world& world, sf::Vector2u mapSize) {
+    world.add<HostAuthority>();
+    world.add<AsteroidTimerComponent>();
+    world.set([&](MapSizeComponent& size) { size.setSize(mapSize); });
+    world.add<SharedLivesComponent>();
+    world.add<ScoreComponent>();
+    world.set(TimerWheelComponent{std::make_shared<TimerWheel>(1.0f / (float)ae::getConfigValue<double>("tps"))});
+
+    float tickBudget = config.tickBudgetMs > 0.0f ? config.tickBudgetMs / 1000.0f : 1.0f / (float)ae::getConfigValue<double>("tps");
+    world.set(OverloadGovernorComponent{std::make_shared<OverloadGovernor>(tickBudget)});
+    world.set(MatchStatsComponent{std::make_shared<MatchStats>()});
+    world.set(ContactStreamComponent{std::make_shared<ContactStream>()});
+    world.set(EntityPoolsComponent{std::make_shared<EntityPool>(), std::make_shared<EntityPool>()});
+    world.set(ReplicationDirtyComponent{std::make_shared<ReplicationDirty>()});
+    resizeContactStream(world);
+}
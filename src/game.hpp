@@ -1,6 +1,15 @@
 #pragma once
 #include "global.hpp"
 #include "component.hpp"
+#include "aggregate.hpp"
+#include "dirty.hpp"
+#include "kernels.hpp"
+#include "governor.hpp"
+#include "stats.hpp"
+#include "bot.hpp"
+#include "fixedstep.hpp"
+#include "profile.hpp"
+#include "metrics.hpp"
 
 inline void createPlayerPolygon(ae::TransformComponent& transform, ae::ShapeComponent& shape) {
 	shape.shape =
@@ -12,6 +21,19 @@ inline void createPlayerPolygon(ae::TransformComponent& transform, ae::ShapeComp
 	polygon.setCollisonMask(PlayerCollisionMask);
 }
 
+// Per-match state is kept in singletons and read from the world passed in,
+// systems pass iter.world() so nothing here assumes one world per process
+inline TimerWheel& getTimerWheel(const flecs::world& world) {
+	return *world.get<TimerWheelComponent>()->wheel;
+}
+
+// Startup shared by the game and the benchmarks
+void applyGameConfig(ae::Config& jConfig);
+void registerNetworkedComponents();
+void registerPrefabs(flecs::world& world);
+// every world singleton the host systems rely on
+void createHostSingletons(flecs::world& world, sf::Vector2u mapSize);
+
 inline void addSoundControlMenu(tgui::BackendGui& gui) {
 	auto musicToggle = tgui::Button::create();
 	musicToggle->setText("Toggle music");
@@ -100,27 +122,34 @@ private:
 class ServerInterface: public ae::ServerInterface {
 public:
 	ServerInterface() {
-		flecs::world& entityWorld = ae::getEntityWorld();
-		entityWorld.add<AsteroidTimerComponent>();
-		entityWorld.set([&](MapSizeComponent& size) { size.setSize(ae::getWindow().getSize()); });
-		entityWorld.add<SharedLivesComponent>();
-		entityWorld.add<ScoreComponent>();
+		createHostSingletons(ae::getEntityWorld(), ae::getWindow().getSize());
 
-		setNetworkUPS(config.stateUPS);
+		networkUPS = config.stateUPS;
+		setNetworkUPS(networkUPS);
 
 		ae::getWindow().setTitle("ECS Asteroids Server");
 	}
 
-	virtual ~ServerInterface() = default;
+	virtual ~ServerInterface() {
+		ae::getEntityWorld().remove<HostAuthority>();
+	}
 
 	void update() override {
-		global->player.set([](PlayerComponent& player){
-			auto input = getInput();
-
+		auto input = config.autoplay ? getBotInput(global->player) : getInput();
+		global->player.set([&](PlayerComponent& player){
 			player.setKeys(input.first);
 			player.setMouse(input.second);
 		});
 
+		float replicationRate = getOverloadGovernor(ae::getEntityWorld()).getReplicationRate();
+		if (replicationRate != networkUPS) {
+			networkUPS = replicationRate;
+			setNetworkUPS(networkUPS);
+		}
+
+		if (config.metricsExportInterval > 0.0f)
+			sampleConnectionMetrics();
+
 #ifndef NDEBUG
 		if(sf::Keyboard::isKeyPressed(sf::Keyboard::Key::F1)) {
 			ae::getEntityWorld().set([](ScoreComponent& score){
@@ -144,6 +173,7 @@ public:
 
 		clients[conn].destruct();
 		clients.erase(conn);
+		getMetrics(ae::getEntityWorld()).removeConnection(conn);
 	}
 
 	void onMessageRecieved(HSteamNetConnection conn, ae::MessageHeader header_, ae::Deserializer& des) override {
@@ -193,9 +223,76 @@ public:
 	}
 
 private:
+	// what each connection really sends and receives, the engine only counts totals
+	void sampleConnectionMetrics() {
+		GameMetrics& metrics = getMetrics(ae::getEntityWorld());
+
+		for (const auto& client : clients) {
+			SteamNetConnectionRealTimeStatus_t status;
+			if (SteamNetworkingSockets()->GetConnectionRealTimeStatus(client.first, &status, 0, nullptr) != k_EResultOK)
+				continue;
+
+			metrics.setConnection(client.first, (double)status.m_nPing / 1000.0,
+				(double)status.m_flOutBytesPerSec, (double)status.m_flInBytesPerSec,
+				(double)(status.m_cbPendingReliable + status.m_cbPendingUnreliable + status.m_cbSentUnackedReliable));
+		}
+	}
+
+	float networkUPS;
 	std::unordered_map<HSteamNetConnection, flecs::entity> clients;
 };
 
+// Entities of one prefab that are parked instead of destroyed. The next spawn
+// reuses a parked entity instead of creating a new entity, physics shape and
+// network id. Parked entities are disabled so systems and queries skip them.
+struct EntityPool {
+	std::vector<flecs::entity_t> parked;
+
+	void release(flecs::entity entity) {
+		ae::getNetworkStateManager().disable(entity);
+		parked.push_back(entity.id());
+	}
+
+	// returns an invalid entity when nothing is parked
+	flecs::entity acquire(flecs::world world) {
+		while(!parked.empty()) {
+			flecs::entity entity(world, parked.back());
+			parked.pop_back();
+
+			if(entity.is_alive())
+				return entity;
+		}
+
+		return flecs::entity();
+	}
+};
+
+// owned by the world like the timer wheel, so parked ids never outlive the
+// world they belong to
+struct EntityPoolsComponent {
+	std::shared_ptr<EntityPool> bullets;
+	std::shared_ptr<EntityPool> asteroids;
+};
+
+inline EntityPool& getBulletPool(const flecs::world& world) {
+	return *world.get<EntityPoolsComponent>()->bullets;
+}
+
+inline EntityPool& getAsteroidPool(const flecs::world& world) {
+	return *world.get<EntityPoolsComponent>()->asteroids;
+}
+
+// the components host systems change often enough to batch their replication
+using ReplicationDirty = DirtySet<ae::TransformComponent, ae::IntegratableComponent, PlayerComponent>;
+
+struct ReplicationDirtyComponent {
+	std::shared_ptr<ReplicationDirty> dirty;
+};
+
+inline ReplicationDirty& getReplicationDirty(const flecs::world& world) {
+	return *world.get<ReplicationDirtyComponent>()->dirty;
+}
+
 class ConnectingState;
 class StartState;
 class ConnectedState;
@@ -222,6 +319,12 @@ public:
 			return;
 		}
 		
+		// autoplay skips the menu and starts a quickplay game straight away
+		if(config.autoplay) {
+			OnQuickplayClick();
+			return;
+		}
+
 		createPlayerInfoMenu(gui);
 
 #ifdef NDEBUG
@@ -522,13 +625,22 @@ private:
 
 void updatePlayerReady(flecs::iter& iter, PlayerComponent* players, ColorComponent* colors, PlayerColorComponent* playerColors);
 void isAllPlayersReady(flecs::iter& iter);
+
+// angle the waiting players orbit the middle of the screen at
+struct OrientContextComponent {
+	float curAngle = 0.0f;
+};
+
 void orientPlayers(flecs::iter& iter, ae::TransformComponent* transforms);
 
 struct HostStartStateModule {
 	HostStartStateModule(flecs::world& world) {
 		world.system<PlayerComponent, ColorComponent, PlayerColorComponent>().kind(flecs::OnUpdate).iter(updatePlayerReady);
 		world.system().kind(flecs::PostUpdate).iter(isAllPlayersReady);
-		world.system<ae::TransformComponent>().with<PlayerComponent>().iter(orientPlayers);
+		world.add<OrientContextComponent>();
+		addFixedStepSystems(world, FIXED_STEP_MOVE, {
+			world.system<ae::TransformComponent>().with<PlayerComponent>().kind(0).iter(orientPlayers)
+		});
 	}
 };
 
@@ -551,53 +663,125 @@ private:
 	}
 };
 
-void updatePlayerDead(flecs::iter& iter, HealthComponent* health);
+// true once every player is dead, ends the match
+bool isMatchOver(const flecs::world& world);
 void isAllPlayersDead(flecs::iter& iter);
 void isDead(flecs::iter& iter, HealthComponent* healths);
 void playerPlayInputUpdate(flecs::iter& iter, PlayerComponent* players, ae::IntegratableComponent* integratables, ae::TransformComponent* transforms, HealthComponent* healths);
 void playerBlinkUpdate(flecs::iter& iter, PlayerComponent* players, HealthComponent* healths, ColorComponent* colors, PlayerColorComponent* playerColors);
 void playerReviveUpdate(flecs::iter& iter, SharedLivesComponent* lives, PlayerComponent* players, HealthComponent* healths);
+struct AsteroidSpawn {
+	sf::Vector2f pos;
+	sf::Vector2f velocity;
+	u8 stage;
+};
+
+// Creates every asteroid in spawns in one batch, used for waves and splits
+void spawnAsteroids(flecs::world world, const TickVector<AsteroidSpawn>& spawns);
+
+// Fires a bullet from origin, reusing a parked bullet when there is one
+void spawnBullet(flecs::world world, const ae::TransformComponent& origin, sf::Vector2f velocity);
+
 void asteroidDestroyUpdate(flecs::iter& iter, AsteroidComponent* asteroids, ae::TransformComponent* transforms, ae::IntegratableComponent* integratables, HealthComponent* healths);
 void transformWrap(flecs::iter& iter, MapSizeComponent* size, ae::TransformComponent* transforms);
 void asteroidAddUpdate(flecs::iter& iter, MapSizeComponent* mapSize, AsteroidTimerComponent* timer);
 void turretPlayUpdate(flecs::iter& iter, ae::TransformComponent* transforms, TurretComponent* turrets);
+void bulletSweepUpdate(flecs::iter& iter, ae::TransformComponent* transforms, BulletComponent* bullets);
+void collisionResolveUpdate(flecs::iter& iter);
+
+struct BulletHit {
+	flecs::entity_t bullet;
+	flecs::entity_t other;
+	float time;
+};
+
+// Collisions are not handled as they happen, instead they are written into this
+// stream and consumed all at once by collisionResolveUpdate. Bullet hits are
+// written into one buffer per flecs stage so workers never share one.
+struct ContactStream {
+	std::vector<std::vector<BulletHit>> bulletHits;
+	std::vector<flecs::entity_t> playerHits;
+
+	// drops contacts nothing resolved yet, so none carry over into the next match
+	void clear() {
+		for (std::vector<BulletHit>& stageHits : bulletHits)
+			stageHits.clear();
+		playerHits.clear();
+	}
+};
+
+struct ContactStreamComponent {
+	std::shared_ptr<ContactStream> stream;
+};
+
+inline ContactStream& getContactStream(const flecs::world& world) {
+	return *world.get<ContactStreamComponent>()->stream;
+}
+
+void resizeContactStream(flecs::world& world);
+
+// Only pipeline systems marked multi_threaded() are split across the workers,
+// and with more than one the pipeline runs them on readonly stages. Fixed step
+// systems, the bullet sweep included, always run on the main thread. Systems
+// that still write through ae::getEntityWorld() or the network state manager
+// are only safe with a single thread, which is why the default is 1.
+void setWorkerThreads(flecs::world& world, u32 threads);
+void timerWheelUpdate(flecs::iter& iter);
+void governorBeginTick(flecs::iter& iter);
+void governorEndTick(flecs::iter& iter);
+void replicationFlush(flecs::iter& iter);
 void observePlayerCollision(flecs::iter& iter, size_t i, ae::ShapeComponent&);
-void observeBulletCollision(flecs::iter& iter, size_t i, ae::ShapeComponent&);
 
 struct HostPlayStateModule {
 	HostPlayStateModule(flecs::world& world) {
-		world.system<HealthComponent>().with<PlayerComponent>().kind(flecs::OnUpdate).with(flecs::Disabled).optional().iter(updatePlayerDead);
 		world.system().kind(flecs::PostUpdate).iter(isAllPlayersDead);
 		world.system<HealthComponent>().iter(isDead);
-		world.system<MapSizeComponent, AsteroidTimerComponent>().term_at(1).singleton().term_at(2).singleton().iter(asteroidAddUpdate);
+		// everything that advances with time or acts once per tick runs once per fixed
+		// step, the governor times each step as one tick
+		addFixedStepSystems(world, FIXED_STEP_BEGIN, { world.system().kind(0).iter(governorBeginTick) });
+		addFixedStepSystems(world, FIXED_STEP_COLLISIONS, {
+			world.system<ae::TransformComponent, BulletComponent>().kind(0).iter(bulletSweepUpdate),
+			world.system().kind(0).iter(collisionResolveUpdate)
+		});
+		addFixedStepSystems(world, FIXED_STEP_TIMERS, { world.system().kind(0).iter(timerWheelUpdate) });
+		addFixedStepSystems(world, FIXED_STEP_UPDATE, {
+			world.system<MapSizeComponent, AsteroidTimerComponent>().term_at(1).singleton().term_at(2).singleton().kind(0).iter(asteroidAddUpdate),
+			world.system<ae::TransformComponent, TurretComponent>().kind(0).iter(turretPlayUpdate),
+			world.system<PlayerComponent, ae::IntegratableComponent, ae::TransformComponent, HealthComponent>().kind(0).iter(playerPlayInputUpdate)
+		});
+		addFixedStepSystems(world, FIXED_STEP_END, { world.system().kind(0).iter(governorEndTick) });
 		world.system<AsteroidComponent, ae::TransformComponent, ae::IntegratableComponent, HealthComponent>().iter(asteroidDestroyUpdate);
 		world.system<SharedLivesComponent, PlayerComponent, HealthComponent>().term_at(1).singleton().iter(playerReviveUpdate);
-		world.system<ae::TransformComponent, TurretComponent>().iter(turretPlayUpdate);
 		world.system<MapSizeComponent, ae::TransformComponent>().term_at(1).singleton().iter(transformWrap);
-		world.system<PlayerComponent, ae::IntegratableComponent, ae::TransformComponent, HealthComponent>().iter(playerPlayInputUpdate);
 		world.observer<ae::ShapeComponent>().event<ae::CollisionEvent>().with<PlayerComponent>().each(observePlayerCollision);
-		world.observer<ae::ShapeComponent>().event<ae::CollisionEvent>().with<BulletComponent>().each(observeBulletCollision);
 		world.system<PlayerComponent, HealthComponent, ColorComponent, PlayerColorComponent>().iter(playerBlinkUpdate);
+		// after every system that marks, before the engine sends
+		world.system().kind(flecs::OnStore).iter(replicationFlush);
 	}
 };
 
+void bulletAdvanceUpdate(flecs::iter& iter, ae::TransformComponent* transforms, BulletComponent* bullets);
+
 struct PlayStateModule {
 	PlayStateModule(flecs::world& world) {
+		addFixedStepSystems(world, FIXED_STEP_MOVE, {
+			world.system<ae::TransformComponent, BulletComponent>().kind(0).iter(bulletAdvanceUpdate)
+		});
 	}
 };
 
 class PlayState : public ae::State {
 public:
 	PlayState() {
-		destroyAsteroids = ae::getEntityWorld().query_builder<AsteroidComponent>().build();
-		destroyBullets = ae::getEntityWorld().query_builder<BulletComponent>().build();
 		resetPlayers = ae::getEntityWorld().query_builder<PlayerComponent, ae::IntegratableComponent, HealthComponent, ColorComponent>()
 			.with(flecs::Disabled).optional().build();
-		destroyTurrets = ae::getEntityWorld().query_builder<TurretComponent>().build();
 	}
 
 	void onEntry() override {
 		createStats(ae::getGui()); 
+
+		if (ae::getNetworkManager().hasNetworkInterface<ServerInterface>())
+			getMatchStats(ae::getEntityWorld()).begin(getTimerWheel(ae::getEntityWorld()).now());
 	}
 
 	void onLeave() override {
@@ -608,18 +792,26 @@ public:
 		if (!ae::getNetworkManager().hasNetworkInterface<ServerInterface>())
 			return;
 
-		world.defer_begin();
-		destroyAsteroids.each([](flecs::entity e, AsteroidComponent& asteroid) {
-			e.destruct();
-			});
-		destroyBullets.each([](flecs::entity e, BulletComponent& asteroid) {
-			e.destruct();
-			});
-		destroyTurrets.each([](flecs::entity e, TurretComponent& turret) {
-			e.destruct();
-			});
+		MatchStats& stats = getMatchStats(world);
+		stats.write(getTimerWheel(world).now(), world.get<ScoreComponent>()->getScore());
+
+		if (config.autoplay && config.autoplayMatches != 0 && stats.matchesPlayed >= config.autoplayMatches) {
+			ae::log("Played %u autoplay matches, results are in %s\n", stats.matchesPlayed, matchStatsPath);
+			ae::getWindow().close();
+		}
+
+		// drops every table holding instances of these prefabs at once, parked
+		// entities included, instead of destructing them one by one
+		world.delete_with(flecs::IsA, world.id<prefabs::Asteroid>());
+		world.delete_with(flecs::IsA, world.id<prefabs::Bullet>());
+		world.delete_with(flecs::IsA, world.id<prefabs::Turret>());
+		getAsteroidPool(world).parked.clear();
+		getBulletPool(world).parked.clear();
+		getAggregateIndex(world).clearAsteroids();
+		getContactStream(world).clear();
 
-		std::vector<flecs::entity> entitiesToEnable;
+		world.defer_begin();
+		TickVector<flecs::entity> entitiesToEnable = makeTickVector<flecs::entity>(world);
 		resetPlayers.each([&](
 			flecs::entity e,
 			PlayerComponent& player,
@@ -627,6 +819,8 @@ public:
 			HealthComponent& health,
 			ColorComponent& color) {
 				player.setIsReady(false);
+				e.remove<PlayerReady>();
+				e.remove<PlayerDead>();
 				integratable.addLinearVelocity(-integratable.getLinearVelocity());
 				health.setDestroyed(false);
 				health.setHealth(1.0f);
@@ -666,10 +860,7 @@ private:
 	}
 
 private:
-	flecs::query<AsteroidComponent> destroyAsteroids;
-	flecs::query<BulletComponent> destroyBullets;
 	flecs::query<PlayerComponent, ae::IntegratableComponent, HealthComponent, ColorComponent> resetPlayers;
-	flecs::query<TurretComponent> destroyTurrets;
 	tgui::Label::Ptr text;
 };
 
@@ -678,7 +869,10 @@ public:
 	HostGameOverStateModule(flecs::world& world) {
 		world.system<PlayerComponent, ColorComponent, PlayerColorComponent>().kind(flecs::OnUpdate).iter(updatePlayerReady);
 		world.system().kind(flecs::PostUpdate).iter(isAllPlayersReady);
-		world.system<ae::TransformComponent>().with<PlayerComponent>().iter(orientPlayers);
+		world.add<OrientContextComponent>();
+		addFixedStepSystems(world, FIXED_STEP_MOVE, {
+			world.system<ae::TransformComponent>().with<PlayerComponent>().kind(0).iter(orientPlayers)
+		});
 	}
 };
 
@@ -5,10 +5,12 @@ bool RandomBool() {
     return (bool)(rand() % 2);
 }
 
-std::vector<sf::Vector2f> generateRandomConvexShape(int size, float scale) {
+TickVector<sf::Vector2f> generateRandomConvexShape(const flecs::world& world, int size, float scale) {
     // Generate two lists of random X and Y coordinates
-    std::vector<float> xPool;
-    std::vector<float> yPool;
+    TickVector<float> xPool = makeTickVector<float>(world);
+    TickVector<float> yPool = makeTickVector<float>(world);
+    xPool.reserve(size);
+    yPool.reserve(size);
 
     for (int i = 0; i < size; i++) {
         xPool.push_back(randomFloat() * 8.0f + 1.0f);
@@ -26,8 +28,10 @@ std::vector<sf::Vector2f> generateRandomConvexShape(int size, float scale) {
     float maxY = yPool[size - 1];
 
     // Divide the interior points into two chains & Extract the vector components
-    std::vector<float> xVec;
-    std::vector<float> yVec;
+    TickVector<float> xVec = makeTickVector<float>(world);
+    TickVector<float> yVec = makeTickVector<float>(world);
+    xVec.reserve(size);
+    yVec.reserve(size);
 
     float lastTop = minX, lastBot = minX;
     for (int i = 1; i < size - 1; i++) {
@@ -64,12 +68,13 @@ std::vector<sf::Vector2f> generateRandomConvexShape(int size, float scale) {
     yVec.push_back(lastRight - maxY);
 
     // Randomly pair up the X- and Y-components
-    std::random_device rd;
-    std::mt19937 g(rd());
+    // seeded once, opening the random device on every call is not cheap
+    static std::mt19937 g(std::random_device{}());
     std::shuffle(yVec.begin(), yVec.end(), g);
 
     // Combine the paired up components into vectors
-    std::vector<sf::Vector2f> vec;
+    TickVector<sf::Vector2f> vec = makeTickVector<sf::Vector2f>(world);
+    vec.reserve(size);
 
     for (int i = 0; i < size; i++) {
         vec.push_back({xVec[i], yVec[i]});
@@ -85,7 +90,8 @@ std::vector<sf::Vector2f> generateRandomConvexShape(int size, float scale) {
     float x = 0, y = 0;
     float minPolygonX = 0;
     float minPolygonY = 0;
-    std::vector<sf::Vector2f> points;
+    TickVector<sf::Vector2f> points = makeTickVector<sf::Vector2f>(world);
+    points.reserve(size);
 
     for (int i = 0; i < size; i++) {
         points.push_back({x, y});
@@ -109,7 +115,7 @@ std::vector<sf::Vector2f> generateRandomConvexShape(int size, float scale) {
     return points;
 }
 
-std::vector<sf::Vector2f> getRandomPregeneratedConvexShape(float scale) {
+TickVector<sf::Vector2f> getRandomPregeneratedConvexShape(const flecs::world& world, float scale) {
     //std::vector<sf::Vector2f> shape = *(asteroidHulls.begin() + (rand() % asteroidHulls.size()));
 
     //for(int i = 0; i < shape.size(); i++) {
@@ -119,5 +125,5 @@ std::vector<sf::Vector2f> getRandomPregeneratedConvexShape(float scale) {
 
     //return shape;
 
-    return generateRandomConvexShape(8, scale);
+    return generateRandomConvexShape(world, 8, scale);
 }
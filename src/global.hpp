@@ -1,8 +1,10 @@
 #pragma once
 #include "base.hpp"
+#include "arena.hpp"
 
-std::vector<sf::Vector2f> generateRandomConvexShape(int size, float scale);
-std::vector<sf::Vector2f> getRandomPregeneratedConvexShape(float scale);
+// the returned vertices live in the tick arena
+TickVector<sf::Vector2f> generateRandomConvexShape(const flecs::world& world, int size, float scale);
+TickVector<sf::Vector2f> getRandomPregeneratedConvexShape(const flecs::world& world, float scale);
 
 inline float randomFloat() {
 	int32_t num = rand();
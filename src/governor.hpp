@@ -0,0 +1,122 @@
+#pragma once
+#include "base.hpp"
+
+// Watches how long server ticks take and steps through degradation levels while
+// they run over budget, then back out once there is headroom again. Each level
+// keeps every level below it active:
+//   1. state replication runs at a fraction of stateUPS
+//   2. at most governorMaxSpawnsPerTick wave asteroids spawn per tick
+//   3. turrets fire at most governorMaxBulletsPerTick bullets per tick
+// At most one spawn interval held back by the cap stays due for later ticks.
+class OverloadGovernor {
+public:
+    enum Step: u32 {
+        STEP_NONE,
+        STEP_REPLICATION,
+        STEP_SPAWN_CAP,
+        STEP_BULLET_CAP,
+        STEP_COUNT
+    };
+
+    explicit OverloadGovernor(float budget)
+        : budget(budget) {}
+
+    void beginTick() {
+        tickStart = std::chrono::steady_clock::now();
+        spawnsLeft = config.governorMaxSpawnsPerTick;
+        bulletsLeft = config.governorMaxBulletsPerTick;
+    }
+
+    void endTick() {
+        lastTickTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - tickStart).count();
+        averageTickTime += (lastTickTime - averageTickTime) * smoothing;
+
+        if (averageTickTime > budget) {
+            overTicks++;
+            underTicks = 0;
+        }
+        else if (averageTickTime < budget * recoverFraction) {
+            underTicks++;
+            overTicks = 0;
+        }
+        else {
+            overTicks = 0;
+            underTicks = 0;
+        }
+
+        if (overTicks >= holdTicks && step + 1 < STEP_COUNT) {
+            step++;
+            overTicks = 0;
+            ae::log("<yellow>Overload governor: %s activated (tick %.2fms, budget %.2fms)<reset>\n",
+                getStepName(step), averageTickTime * 1000.0f, budget * 1000.0f);
+        }
+        else if (underTicks >= holdTicks && step > STEP_NONE) {
+            ae::log("<green>Overload governor: %s cleared (tick %.2fms, budget %.2fms)<reset>\n",
+                getStepName(step), averageTickTime * 1000.0f, budget * 1000.0f);
+            step--;
+            underTicks = 0;
+        }
+    }
+
+    bool isActive(Step check) const { return step >= check; }
+
+    float getReplicationRate() const {
+        return isActive(STEP_REPLICATION) ? config.stateUPS * config.governorReplicationScale : config.stateUPS;
+    }
+
+    // returns false once the cap for this tick is used up
+    bool takeSpawn() {
+        return take(STEP_SPAWN_CAP, spawnsLeft);
+    }
+
+    bool takeBullet() {
+        return take(STEP_BULLET_CAP, bulletsLeft);
+    }
+
+    float getLastTickTime() const { return lastTickTime; }
+    float getAverageTickTime() const { return averageTickTime; }
+    float getBudget() const { return budget; }
+
+private:
+    static constexpr float smoothing = 0.1f;
+    static constexpr float recoverFraction = 0.7f;
+    static constexpr u32 holdTicks = 30;
+
+    static const char* getStepName(u32 step) {
+        switch (step) {
+        case STEP_REPLICATION: return "reduced replication rate";
+        case STEP_SPAWN_CAP: return "asteroid spawn cap";
+        case STEP_BULLET_CAP: return "turret bullet cap";
+        default: return "none";
+        }
+    }
+
+    bool take(Step cap, u32& left) {
+        if (!isActive(cap))
+            return true;
+        if (left == 0)
+            return false;
+
+        left--;
+        return true;
+    }
+
+private:
+    float budget;
+    float lastTickTime = 0.0f;
+    float averageTickTime = 0.0f;
+    u32 step = STEP_NONE;
+    u32 overTicks = 0;
+    u32 underTicks = 0;
+    u32 spawnsLeft = 0;
+    u32 bulletsLeft = 0;
+    std::chrono::steady_clock::time_point tickStart;
+};
+
+struct OverloadGovernorComponent {
+    std::shared_ptr<OverloadGovernor> governor;
+};
+
+inline OverloadGovernor& getOverloadGovernor(const flecs::world& world) {
+    return *world.get<OverloadGovernorComponent>()->governor;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "base.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define ASTEROIDS_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ASTEROIDS_SSE2
+#endif
+
+// Batch kernels over positions stored as separate x and y arrays. Callers
+// gather components into batches of at most 64, so the kernels can return
+// which entries changed as one bitmask.
+constexpr u32 kernelBatchSize = 64;
+
+inline bool wrapScalar(float& value, float size) {
+    if (value >= size) {
+        value = 0.0f;
+        return true;
+    }
+    else if (value <= 0.0f) {
+        value = size;
+        return true;
+    }
+
+    return false;
+}
+
+// Wraps count (at most kernelBatchSize) positions around a width x height map.
+// A coordinate at or past the far edge moves to 0 and one at or before 0 moves
+// to the far edge. Bit i of the result is set when position i moved.
+inline u64 wrapPositions(float* xs, float* ys, u32 count, float width, float height) {
+    u64 moved = 0;
+    u32 i = 0;
+
+#if defined(ASTEROIDS_AVX)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 w = _mm256_set1_ps(width);
+    const __m256 h = _mm256_set1_ps(height);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 x = _mm256_loadu_ps(xs + i);
+        __m256 y = _mm256_loadu_ps(ys + i);
+
+        __m256 overX = _mm256_cmp_ps(x, w, _CMP_GE_OQ);
+        __m256 underX = _mm256_andnot_ps(overX, _mm256_cmp_ps(x, zero, _CMP_LE_OQ));
+        __m256 overY = _mm256_cmp_ps(y, h, _CMP_GE_OQ);
+        __m256 underY = _mm256_andnot_ps(overY, _mm256_cmp_ps(y, zero, _CMP_LE_OQ));
+
+        __m256 changedX = _mm256_or_ps(overX, underX);
+        __m256 changedY = _mm256_or_ps(overY, underY);
+        x = _mm256_or_ps(_mm256_andnot_ps(changedX, x), _mm256_and_ps(underX, w));
+        y = _mm256_or_ps(_mm256_andnot_ps(changedY, y), _mm256_and_ps(underY, h));
+
+        _mm256_storeu_ps(xs + i, x);
+        _mm256_storeu_ps(ys + i, y);
+        moved |= (u64)_mm256_movemask_ps(_mm256_or_ps(changedX, changedY)) << i;
+    }
+#elif defined(ASTEROIDS_SSE2)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 w = _mm_set1_ps(width);
+    const __m128 h = _mm_set1_ps(height);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+
+        __m128 overX = _mm_cmpge_ps(x, w);
+        __m128 underX = _mm_andnot_ps(overX, _mm_cmple_ps(x, zero));
+        __m128 overY = _mm_cmpge_ps(y, h);
+        __m128 underY = _mm_andnot_ps(overY, _mm_cmple_ps(y, zero));
+
+        __m128 changedX = _mm_or_ps(overX, underX);
+        __m128 changedY = _mm_or_ps(overY, underY);
+        x = _mm_or_ps(_mm_andnot_ps(changedX, x), _mm_and_ps(underX, w));
+        y = _mm_or_ps(_mm_andnot_ps(changedY, y), _mm_and_ps(underY, h));
+
+        _mm_storeu_ps(xs + i, x);
+        _mm_storeu_ps(ys + i, y);
+        moved |= (u64)_mm_movemask_ps(_mm_or_ps(changedX, changedY)) << i;
+    }
+#endif
+
+    for (; i < count; i++) {
+        bool changedX = wrapScalar(xs[i], width);
+        bool changedY = wrapScalar(ys[i], height);
+        if (changedX || changedY)
+            moved |= (u64)1 << i;
+    }
+
+    return moved;
+}
+
+// Moves count positions along their velocities. The loop has no branches and
+// no aliasing between the arrays, so the compiler vectorizes it on its own.
+inline void advancePositions(float* __restrict xs, float* __restrict ys, const float* __restrict velocityXs, const float* __restrict velocityYs, u32 count, float deltaTime) {
+    for (u32 i = 0; i < count; i++) {
+        xs[i] += velocityXs[i] * deltaTime;
+        ys[i] += velocityYs[i] * deltaTime;
+    }
+}
@@ -0,0 +1,324 @@
+#pragma once
+#include "aggregate.hpp"
+#include <cstring>
+
+constexpr const char* metricsPath = "./metrics.prom";
+
+// Counters only go up, a scraper derives rates from them. Safe to add to
+// from any thread.
+class Counter {
+public:
+    void add(u64 amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+    u64 get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<u64> value = 0;
+};
+
+class Gauge {
+public:
+    void set(double newValue) { value.store(newValue, std::memory_order_relaxed); }
+    double get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value = 0.0;
+};
+
+// Counts observations into buckets by upper bound, main thread only
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds)
+        : bounds(std::move(bounds)), buckets(this->bounds.size() + 1, 0) {}
+
+    void observe(double value) {
+        size_t bucket = std::lower_bound(bounds.begin(), bounds.end(), value) - bounds.begin();
+        buckets[bucket]++;
+        sum += value;
+        count++;
+    }
+
+    const std::vector<double>& getBounds() const { return bounds; }
+    const std::vector<u64>& getBuckets() const { return buckets; }
+    double getSum() const { return sum; }
+    u64 getCount() const { return count; }
+
+private:
+    std::vector<double> bounds;
+    std::vector<u64> buckets; // the last one is +Inf
+    double sum = 0.0;
+    u64 count = 0;
+};
+
+// Owns every metric and writes them in the Prometheus text format. Metrics are
+// registered once at startup and kept by reference, a series is its family
+// name plus an optional label set such as component="HealthComponent".
+class MetricsRegistry {
+public:
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return *getSeries(name, help, "counter", labels).counter;
+    }
+
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "") {
+        return *getSeries(name, help, "gauge", labels).gauge;
+    }
+
+    Histogram& histogram(const std::string& name, const std::string& help, std::vector<double> bounds, const std::string& labels = "") {
+        Series& series = getSeries(name, help, "histogram", labels);
+        if (!series.histogram)
+            series.histogram = std::make_unique<Histogram>(std::move(bounds));
+
+        return *series.histogram;
+    }
+
+    std::string exposition() const {
+        std::string text;
+        for (const auto& [name, family] : families) {
+            text += ae::formatString("# HELP %s %s\n# TYPE %s %s\n", name.c_str(), family.help.c_str(), name.c_str(), family.type);
+
+            for (const Series& series : family.series) {
+                if (series.counter)
+                    text += ae::formatString("%s%s %llu\n", name.c_str(), braced(series.labels).c_str(), (unsigned long long)series.counter->get());
+                else if (series.gauge)
+                    text += ae::formatString("%s%s %.6g\n", name.c_str(), braced(series.labels).c_str(), series.gauge->get());
+                else if (series.histogram)
+                    text += histogramExposition(name, series.labels, *series.histogram);
+            }
+        }
+
+        return text;
+    }
+
+    // drops one series, for label sets that stop existing such as a closed connection
+    void remove(const std::string& name, const std::string& labels) {
+        auto family = families.find(name);
+        if (family == families.end())
+            return;
+
+        std::vector<Series>& series = family->second.series;
+        series.erase(std::remove_if(series.begin(), series.end(), [&](const Series& entry) { return entry.labels == labels; }), series.end());
+        if (series.empty())
+            families.erase(family);
+    }
+
+    // written next to path and renamed over it, so a scraper never reads half a file
+    bool write(const char* path) const {
+        std::string temporaryPath = std::string(path) + ".tmp";
+        FILE* file = std::fopen(temporaryPath.c_str(), "w");
+        if (file == nullptr)
+            return false;
+
+        std::string text = exposition();
+        bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        std::fclose(file);
+
+        return written && std::rename(temporaryPath.c_str(), path) == 0;
+    }
+
+private:
+    struct Series {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family {
+        std::string help;
+        const char* type;
+        std::vector<Series> series;
+    };
+
+    Series& getSeries(const std::string& name, const std::string& help, const char* type, const std::string& labels) {
+        Family& family = families[name];
+        family.help = help;
+        family.type = type;
+
+        for (Series& series : family.series) {
+            if (series.labels == labels)
+                return series;
+        }
+
+        Series& series = family.series.emplace_back();
+        series.labels = labels;
+        if (std::strcmp(type, "counter") == 0)
+            series.counter = std::make_unique<Counter>();
+        else if (std::strcmp(type, "gauge") == 0)
+            series.gauge = std::make_unique<Gauge>();
+
+        return series;
+    }
+
+    static std::string braced(const std::string& labels) {
+        return labels.empty() ? "" : "{" + labels + "}";
+    }
+
+    static std::string histogramExposition(const std::string& name, const std::string& labels, const Histogram& histogram) {
+        std::string text;
+        std::string prefix = labels.empty() ? "" : labels + ",";
+        u64 cumulative = 0;
+
+        for (size_t i = 0; i < histogram.getBuckets().size(); i++) {
+            cumulative += histogram.getBuckets()[i];
+            std::string bound = i < histogram.getBounds().size() ? ae::formatString("%g", histogram.getBounds()[i]) : "+Inf";
+            text += ae::formatString("%s_bucket{%sle=\"%s\"} %llu\n", name.c_str(), prefix.c_str(), bound.c_str(), (unsigned long long)cumulative);
+        }
+
+        text += ae::formatString("%s_sum%s %.6g\n", name.c_str(), braced(labels).c_str(), histogram.getSum());
+        text += ae::formatString("%s_count%s %llu\n", name.c_str(), braced(labels).c_str(), (unsigned long long)histogram.getCount());
+        return text;
+    }
+
+private:
+    std::map<std::string, Family> families;
+};
+
+// bytes one instance of T takes in a message, without the message's own framing
+template<typename T>
+u32 getSerializedSize() {
+    ae::MessageBuffer empty;
+    ae::Serializer emptySer = ae::startSerialize(empty);
+    ae::endSerialize(emptySer, empty);
+
+    T value;
+    ae::MessageBuffer buffer;
+    ae::Serializer ser = ae::startSerialize(buffer);
+    ser.object(value);
+    ae::endSerialize(ser, buffer);
+
+    return (u32)(buffer.size() - empty.size());
+}
+
+// The metrics the game reports, registered once so hot paths add to them
+// without looking anything up.
+struct GameMetrics {
+    MetricsRegistry registry;
+
+    Counter& networkWrittenBytes = registry.counter("asteroids_network_written_bytes_total", "Bytes written to every connection");
+    Counter& networkReadBytes = registry.counter("asteroids_network_read_bytes_total", "Bytes read from every connection");
+    Histogram& tickSeconds = registry.histogram("asteroids_tick_seconds", "Host tick time",
+        {0.001, 0.002, 0.004, 0.008, 0.016, 0.033, 0.066, 0.133});
+
+    Counter& asteroidsSpawned = registry.counter("asteroids_asteroids_spawned_total", "Asteroids spawned, splits included");
+    Counter& asteroidsDestroyed = registry.counter("asteroids_asteroids_destroyed_total", "Asteroids destroyed");
+    Counter& bulletsFired = registry.counter("asteroids_bullets_fired_total", "Bullets fired by players and turrets");
+    Counter& turretsPlaced = registry.counter("asteroids_turrets_placed_total", "Turrets placed by players");
+
+    Gauge& players = registry.gauge("asteroids_entities", "Live entities by prefab", "prefab=\"player\"");
+    Gauge& asteroids = registry.gauge("asteroids_entities", "Live entities by prefab", "prefab=\"asteroid\"");
+    Gauge& turrets = registry.gauge("asteroids_entities", "Live entities by prefab", "prefab=\"turret\"");
+    Gauge& bullets = registry.gauge("asteroids_entities", "Live entities by prefab", "prefab=\"bullet\"");
+    Gauge& networkedEntities = registry.gauge("asteroids_networked_entities", "Entities replicated to clients");
+
+    // the engine serializes transforms itself, so they are counted instead of measured
+    Counter& transformUpdates = registry.counter("asteroids_replicated_transform_updates_total", "Modified transforms sent to clients");
+    std::vector<const Counter*> replicatedBytes; // one per watched component
+
+    // Estimates what the engine replicates, it sends a networked component
+    // whenever it is modified. The engine frames and batches the messages
+    // itself and reports only totals, so this is modifications times the
+    // serialized size. What was really sent is in the per connection series.
+    template<typename T>
+    void watchReplication(flecs::world& world, const char* name) {
+        Counter& bytes = registry.counter("asteroids_replicated_component_bytes_total",
+            "Estimated bytes of modified networked components, by component", ae::formatString("component=\"%s\"", name));
+        u32 size = getSerializedSize<T>();
+        replicatedBytes.push_back(&bytes);
+
+        world.observer<T>().event(flecs::OnSet).each([&bytes, size](flecs::entity, T&) { bytes.add(size); });
+    }
+
+    // bytes of every watched component so far, what each client was sent
+    u64 getReplicatedBytes() const {
+        u64 total = 0;
+        for (const Counter* bytes : replicatedBytes)
+            total += bytes->get();
+
+        return total;
+    }
+
+    // bullets that are in play, parked ones are disabled and skipped
+    flecs::query<> liveBullets;
+
+    // gauges are sampled when they are written instead of kept up to date
+    void sample(flecs::world world) {
+        AggregateIndex& index = getAggregateIndex(world);
+        players.set((double)index.players);
+        asteroids.set((double)index.asteroids);
+        turrets.set((double)index.turrets);
+
+        size_t bulletCount = 0;
+        liveBullets.iter([&](flecs::iter& iter) { bulletCount += iter.count(); });
+        bullets.set((double)bulletCount);
+
+        networkedEntities.set((double)world.count<ae::NetworkedEntity>());
+    }
+
+    // the series of one connection, labelled by its handle
+    void setConnection(u32 connection, double pingSeconds, double sentBytesPerSecond, double receivedBytesPerSecond, double queuedBytes) {
+        std::string labels = ae::formatString("connection=\"%u\"", connection);
+        registry.gauge(connectionSeries[0], "Round trip time of a connection", labels).set(pingSeconds);
+        registry.gauge(connectionSeries[1], "Bytes a connection sends per second", labels).set(sentBytesPerSecond);
+        registry.gauge(connectionSeries[2], "Bytes a connection receives per second", labels).set(receivedBytesPerSecond);
+        registry.gauge(connectionSeries[3], "Bytes queued on a connection and not yet sent", labels).set(queuedBytes);
+    }
+
+    void removeConnection(u32 connection) {
+        std::string labels = ae::formatString("connection=\"%u\"", connection);
+        for (const char* name : connectionSeries)
+            registry.remove(name, labels);
+    }
+
+private:
+    static constexpr const char* connectionSeries[] = {
+        "asteroids_connection_ping_seconds",
+        "asteroids_connection_sent_bytes_per_second",
+        "asteroids_connection_received_bytes_per_second",
+        "asteroids_connection_queued_bytes"
+    };
+};
+
+struct GameMetricsComponent {
+    std::shared_ptr<GameMetrics> metrics;
+};
+
+inline GameMetrics& getMetrics(const flecs::world& world) {
+    return *world.get<GameMetricsComponent>()->metrics;
+}
+
+// Writes every metric to metricsPath every config.metricsExportInterval
+// seconds, for a Prometheus textfile collector to pick up. An interval of 0
+// never writes, the metrics are still counted.
+struct MetricsModule {
+    MetricsModule(flecs::world& world) {
+        std::shared_ptr<GameMetrics> metrics = std::make_shared<GameMetrics>();
+        metrics->liveBullets = world.query_builder<>().with<BulletComponent>().build();
+        world.set(GameMetricsComponent{metrics});
+
+        metrics->watchReplication<SharedLivesComponent>(world, "SharedLivesComponent");
+        metrics->watchReplication<ScoreComponent>(world, "ScoreComponent");
+        metrics->watchReplication<HealthComponent>(world, "HealthComponent");
+        metrics->watchReplication<ColorComponent>(world, "ColorComponent");
+        metrics->watchReplication<PlayerColorComponent>(world, "PlayerColorComponent");
+        metrics->watchReplication<PlayerComponent>(world, "PlayerComponent");
+        metrics->watchReplication<AsteroidComponent>(world, "AsteroidComponent");
+        metrics->watchReplication<BulletComponent>(world, "BulletComponent");
+        metrics->watchReplication<MapSizeComponent>(world, "MapSizeComponent");
+        metrics->watchReplication<TurretComponent>(world, "TurretComponent");
+        world.observer<ae::TransformComponent>().event(flecs::OnSet)
+            .each([metrics](flecs::entity, ae::TransformComponent&) { metrics->transformUpdates.add(); });
+
+        world.system().kind(flecs::OnStore).iter([metrics, sinceExport = 0.0f](flecs::iter& iter) mutable {
+            if (config.metricsExportInterval <= 0.0f)
+                return;
+
+            sinceExport += iter.delta_time();
+            if (sinceExport < config.metricsExportInterval)
+                return;
+
+            sinceExport = 0.0f;
+            metrics->sample(iter.world());
+            if (!metrics->registry.write(metricsPath))
+                ae::log(ae::ERROR_SEVERITY_WARNING, "Failed to write metrics to %s\n", metricsPath);
+        });
+    }
+};
@@ -0,0 +1,276 @@
+#pragma once
+#include "base.hpp"
+
+// Timeline profiler. PROFILE_ZONE("name") records how long the rest of the
+// scope took, PROFILE_FUNCTION() does the same named after the function. Every
+// thread writes its zones into its own ring buffer without locking, and the
+// buffers are written out as Chrome trace event JSON, which Perfetto and
+// chrome://tracing open, when F6 is pressed or the process gets SIGUSR1.
+//
+// Zones only exist when ASTEROIDS_PROFILE is defined (cmake -DASTEROIDS_PROFILE=ON),
+// otherwise the macros expand to nothing and cost nothing.
+
+#ifdef ASTEROIDS_PROFILE
+
+#include <csignal>
+
+// zones kept per thread, older zones are overwritten
+constexpr u64 traceBufferSize = 1 << 16;
+
+struct TraceEvent {
+    const char* name; // must outlive the profiler, string literals or __func__
+    u64 start;        // ns since the profiler started
+    u64 duration;
+};
+
+// Written only by the thread it belongs to. The head is published after the
+// event is written, so a dump between frames, while workers are idle, sees
+// whole events.
+class TraceBuffer {
+public:
+    explicit TraceBuffer(u32 threadId)
+        : threadId(threadId), events(traceBufferSize) {}
+
+    void push(const char* name, u64 start, u64 duration) {
+        u64 index = head.load(std::memory_order_relaxed);
+        events[index & (traceBufferSize - 1)] = {name, start, duration};
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    template<typename F>
+    void forEach(F&& callback) const {
+        u64 end = head.load(std::memory_order_acquire);
+        u64 begin = end > traceBufferSize ? end - traceBufferSize : 0;
+        for (u64 i = begin; i < end; i++)
+            callback(events[i & (traceBufferSize - 1)]);
+    }
+
+    u32 getThreadId() const { return threadId; }
+
+private:
+    u32 threadId;
+    std::vector<TraceEvent> events;
+    std::atomic<u64> head = 0;
+};
+
+class Profiler {
+public:
+    Profiler() : epoch(std::chrono::steady_clock::now()) {}
+
+    u64 now() const {
+        return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // the lock is only taken once per thread, the first time it records a zone
+    TraceBuffer& registerThread() {
+        std::lock_guard<std::mutex> lock(mutex);
+        buffers.push_back(std::make_unique<TraceBuffer>((u32)buffers.size()));
+        return *buffers.back();
+    }
+
+    bool dump(const char* path) {
+        FILE* file = std::fopen(path, "w");
+        if (file == nullptr)
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+        bool first = true;
+        for (const std::unique_ptr<TraceBuffer>& buffer : buffers) {
+            u32 tid = buffer->getThreadId();
+            std::fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s %u\"}}",
+                first ? "" : ",\n", tid, tid == 0 ? "main" : "worker", tid);
+            first = false;
+
+            buffer->forEach([&](const TraceEvent& event) {
+                std::fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                    event.name, tid, (double)event.start / 1000.0, (double)event.duration / 1000.0);
+            });
+        }
+
+        std::fprintf(file, "\n]}\n");
+        std::fclose(file);
+        return true;
+    }
+
+private:
+    std::chrono::steady_clock::time_point epoch;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+};
+
+inline Profiler& getProfiler() {
+    static Profiler profiler;
+    return profiler;
+}
+
+inline TraceBuffer& getThreadTraceBuffer() {
+    thread_local TraceBuffer& buffer = getProfiler().registerThread();
+    return buffer;
+}
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name)
+        : name(name), start(getProfiler().now()) {}
+
+    ~ProfileZone() {
+        getThreadTraceBuffer().push(name, start, getProfiler().now() - start);
+    }
+
+private:
+    const char* name;
+    u64 start;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+
+// a plain lock free flag, so the signal handler may set it
+inline std::atomic<bool> traceDumpRequested = false;
+
+// Writes a trace when one was asked for, call once a frame from the main thread
+inline void pollTraceDump() {
+    if (!traceDumpRequested.exchange(false, std::memory_order_relaxed))
+        return;
+
+    static u32 dumpCount = 0;
+    std::string path = ae::formatString("./trace_%u.json", dumpCount++);
+    if (getProfiler().dump(path.c_str()))
+        ae::log("Wrote trace to %s\n", path.c_str());
+    else
+        ae::log(ae::ERROR_SEVERITY_WARNING, "Failed to write trace to %s\n", path.c_str());
+}
+
+inline void requestTraceDump() {
+    traceDumpRequested.store(true, std::memory_order_relaxed);
+}
+
+// the handler only sets a flag, the trace is written by pollTraceDump()
+inline void installTraceSignal() {
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, [](int) { requestTraceDump(); });
+#endif
+}
+
+// Wraps every pipeline phase in a zone, so time between systems shows up under
+// the phase it was spent in. Each phase zone is opened by a system that runs
+// first in that phase and closed when the next phase starts, the last one after
+// the frame. Systems in a phase run in the order they were created, so main
+// imports it before the engine's modules and the game's, any system created
+// earlier runs outside of its phase zone.
+//
+// Every other system, the engine's and phaseless ones run by hand included, is
+// given a zone of its own named after its path. After every frame the systems
+// created since the last one get a run callback that opens the zone and then
+// iterates like flecs does by default, so a system is timed from the frame
+// after the one it was created in.
+struct ProfileModule {
+    struct PhaseZone {
+        const char* name = nullptr;
+        u64 start = 0;
+    };
+
+    static inline PhaseZone open;
+
+    // every system looked at so far by its zone name, the phase systems included.
+    // Never erased, since recorded zones point at the names.
+    static inline std::unordered_map<flecs::entity_t, std::string> systemZones;
+    static inline flecs::filter<> systems;
+
+    static void closePhase() {
+        if (open.name == nullptr)
+            return;
+
+        getThreadTraceBuffer().push(open.name, open.start, getProfiler().now() - open.start);
+        open.name = nullptr;
+    }
+
+    static void runProfiledSystem(ecs_iter_t* it) {
+        ProfileZone zone(systemZones.find(it->system)->second.c_str());
+
+        // a system without terms is called once, the same as without a run callback
+        if (it->field_count == 0) {
+            it->callback(it);
+            ecs_iter_fini(it);
+            return;
+        }
+
+        while (ecs_iter_next(it))
+            it->callback(it);
+    }
+
+    // runs after the frame, when no system runs and the world is writable
+    static void profileNewSystems(ecs_world_t* world) {
+        systems.each([world](flecs::entity system) {
+            if (systemZones.find(system.id()) != systemZones.end())
+                return;
+
+            systemZones[system.id()] = system.path().c_str();
+
+            // the contexts are passed back unchanged, ecs_system_init frees the ones it replaces
+            ecs_system_desc_t desc = {};
+            desc.entity = system.id();
+            desc.run = runProfiledSystem;
+            desc.ctx = ecs_system_get_ctx(world, system.id());
+            desc.binding_ctx = ecs_system_get_binding_ctx(world, system.id());
+            ecs_system_init(world, &desc);
+        });
+    }
+
+    ProfileModule(flecs::world& world) {
+        const std::array<std::pair<flecs::entity_t, const char*>, 8> phases = {{
+            {flecs::OnLoad, "OnLoad"},
+            {flecs::PostLoad, "PostLoad"},
+            {flecs::PreUpdate, "PreUpdate"},
+            {flecs::OnUpdate, "OnUpdate"},
+            {flecs::OnValidate, "OnValidate"},
+            {flecs::PostUpdate, "PostUpdate"},
+            {flecs::PreStore, "PreStore"},
+            {flecs::OnStore, "OnStore"},
+        }};
+
+        systems = world.filter_builder<>()
+            .term(ecs_id(EcsPoly), EcsSystem)
+            .filter_flags(EcsFilterMatchDisabled)
+            .build();
+
+        for (const auto& entry : phases) {
+            flecs::entity_t phase = entry.first;
+            const char* name = entry.second;
+
+            flecs::system system = world.system().kind(phase).iter([phase, name](flecs::iter& iter) {
+                closePhase();
+                open = {name, getProfiler().now()};
+
+                if (phase == flecs::OnLoad) {
+                    ecs_run_post_frame(iter.world().c_ptr(), [](ecs_world_t* world, void*) {
+                        closePhase();
+                        profileNewSystems(const_cast<ecs_world_t*>(ecs_get_world(world)));
+                    }, nullptr);
+                }
+            });
+
+            // the phase zones already cover them
+            systemZones[system.id()] = name;
+        }
+    }
+};
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_FUNCTION() ((void)0)
+
+inline void pollTraceDump() {}
+inline void requestTraceDump() {}
+inline void installTraceSignal() {}
+
+struct ProfileModule {
+    ProfileModule(flecs::world&) {}
+};
+
+#endif
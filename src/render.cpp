@@ -0,0 +1,143 @@
+#include "render.hpp"
+
+// anything that moved further than this in one tick wrapped around the map or
+// was respawned, so it is drawn where it is instead of sliding across the screen
+constexpr float maxInterpolationDistance = 100.0f;
+
+const sf::Color outlineColor = sf::Color(54, 69, 79);
+
+SceneRenderer::SceneRenderer(flecs::world& world)
+    : world(world) {
+    turretQuery = world.query<TurretComponent, ae::TransformComponent>();
+    bulletQuery = world.query<BulletComponent, ae::TransformComponent, ColorComponent>();
+    shapeQuery = world.query<ae::ShapeComponent, ColorComponent, ae::TransformComponent>();
+
+    // a pooled asteroid is still disabled when its new shape is set, so these
+    // match disabled entities, and it is dropped again when it is enabled in
+    // case the shape was changed without being set
+    world.observer<ae::ShapeComponent>().event(flecs::OnSet).event(flecs::OnRemove).filter_flags(EcsFilterMatchDisabled)
+        .each([this](flecs::entity e, ae::ShapeComponent&) { meshCache.invalidate(e.id()); });
+    world.observer<ae::ShapeComponent>().with(flecs::Disabled).event(flecs::OnRemove).filter_flags(EcsFilterMatchDisabled)
+        .each([this](flecs::entity e, ae::ShapeComponent&) { meshCache.invalidate(e.id()); });
+}
+
+void SceneRenderer::capture(ae::PhysicsWorld& physicsWorld, u32 steps) {
+    PROFILE_ZONE("SceneRenderer::capture");
+    stepsBetween = std::max(steps, 1u);
+
+    previousIndex.clear();
+    for (u32 i = 0; i < snapshots[current].items.size(); i++)
+        previousIndex[snapshots[current].items[i].entity] = i;
+
+    current ^= 1;
+    RenderSnapshot& snapshot = snapshots[current];
+    snapshot.items.clear();
+
+    turretQuery.each([&](flecs::entity e, TurretComponent&, ae::TransformComponent& transform) {
+        snapshot.items.push_back({e.id(), RenderKind::Turret, transform.getPos(), transform.getRot(), 20.0f, sf::Color::Yellow});
+    });
+
+    bulletQuery.each([&](flecs::entity e, BulletComponent&, ae::TransformComponent& transform, ColorComponent& color) {
+        snapshot.items.push_back({e.id(), RenderKind::Bullet, transform.getPos(), 0.0f, bulletRadius, color.getColor()});
+    });
+
+    shapeQuery.each([&](flecs::entity e, ae::ShapeComponent& shape, ColorComponent& color, ae::TransformComponent& transform) {
+        if (!physicsWorld.doesShapeExist(shape.shape)) {
+            ae::log("Invalid shape id %u - %u\n", e.id(), shape.shape);
+            return;
+        }
+
+        ae::Shape& physicsShape = physicsWorld.getShape(shape.shape);
+
+        switch (physicsShape.getType()) {
+        case ae::ShapeEnum::Polygon:
+            meshCache.get(e.id(), physicsShape, transform);
+            snapshot.items.push_back({e.id(), RenderKind::Polygon, transform.getPos(), transform.getRot(), 0.0f, color.getColor()});
+            break;
+        case ae::ShapeEnum::Circle: {
+            ae::Circle& circle = dynamic_cast<ae::Circle&>(physicsShape);
+            snapshot.items.push_back({e.id(), RenderKind::Circle, circle.getPos(), 0.0f, circle.getRadius(), color.getColor()});
+        } break;
+        }
+    });
+}
+
+u32 SceneRenderer::draw(sf::RenderTarget& target, bool debugShow, float alpha) {
+    PROFILE_ZONE("SceneRenderer::draw");
+
+    // drawing is one step behind the latest snapshot, which may be several
+    // steps after the previous one
+    float blend = 1.0f - (1.0f - alpha) / (float)stepsBetween;
+
+    for (const RenderItem& item : snapshots[current].items) {
+        sf::Vector2f pos = item.pos;
+        float rot = item.rot;
+
+        const RenderItem* previous = findPrevious(item.entity);
+        if (previous != nullptr && (item.pos - previous->pos).length() < maxInterpolationDistance) {
+            float rotDelta = std::remainder(item.rot - previous->rot, 2.0f * 3.14159265359f);
+            pos = previous->pos + (item.pos - previous->pos) * blend;
+            rot = item.rot - rotDelta * (1.0f - blend);
+        }
+
+        switch (item.kind) {
+        case RenderKind::Turret:
+            if (debugShow) {
+                sf::Vector2f range = sf::Vector2f(config.turretRange, config.turretRange) * 2.0f;
+                appendRectangle(array, pos, range, 0.0f, sf::Color::Transparent, 2.5f, sf::Color::Red);
+            }
+
+            appendCircle(array, pos, item.radius, item.color, 2.0f, outlineColor);
+            appendRectangle(array, pos, sf::Vector2f(20.0f, 10.0f), rot, sf::Color::Magenta, 2.0f, outlineColor);
+            break;
+        case RenderKind::Bullet:
+        case RenderKind::Circle:
+            appendCircle(array, pos, item.radius, item.color, 2.0f, outlineColor);
+            break;
+        case RenderKind::Polygon: {
+            const std::vector<sf::Vector2f>* mesh = meshCache.find(item.entity);
+            if (mesh == nullptr)
+                break;
+
+            appendMesh(array, *mesh, pos, rot, item.color);
+        } break;
+        }
+    }
+
+    u32 drawCalls = 0;
+    if (array.getVertexCount() != 0) {
+        PROFILE_ZONE("SceneRenderer::submit");
+        target.draw(array);
+        drawCalls++;
+    }
+    array.clear();
+
+    return drawCalls;
+}
+
+void SceneRenderer::drawDebugLabels(sf::RenderTarget& target, sf::Text& text) {
+    for (const RenderItem& item : snapshots[current].items) {
+        if (item.kind != RenderKind::Polygon && item.kind != RenderKind::Circle)
+            continue;
+
+        flecs::entity e(world, item.entity);
+        if (e.is_alive() && e.has<ae::NetworkedEntity>())
+            text.setFillColor(sf::Color::Green);
+        else
+            text.setFillColor(sf::Color::Red);
+
+        text.setString(ae::formatString("Entity: %lu", item.entity & ECS_ENTITY_MASK));
+        text.setPosition(item.pos);
+        target.draw(text);
+    }
+
+    text.setFillColor(sf::Color::Black);
+}
+
+const RenderItem* SceneRenderer::findPrevious(flecs::entity_t entity) const {
+    auto it = previousIndex.find(entity);
+    if (it == previousIndex.end())
+        return nullptr;
+
+    return &snapshots[current ^ 1].items[it->second];
+}
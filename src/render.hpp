@@ -0,0 +1,205 @@
+#pragma once
+#include "component.hpp"
+#include "profile.hpp"
+
+// Helpers that tessellate shapes into a triangle sf::VertexArray, so the whole
+// scene can be drawn with one draw call instead of one per sf::Shape. Outlines
+// are drawn inside the shape's edge, like an sf::Shape with a negative outline
+// thickness.
+constexpr u32 circleSegments = 16;
+
+inline const std::array<sf::Vector2f, circleSegments>& getUnitCircle() {
+    static const std::array<sf::Vector2f, circleSegments> unitCircle = [](){
+        std::array<sf::Vector2f, circleSegments> points;
+        for (u32 i = 0; i < circleSegments; i++) {
+            float angle = 2.0f * 3.14159265359f * (float)i / (float)circleSegments;
+            points[i] = {std::cos(angle), std::sin(angle)};
+        }
+
+        return points;
+    }();
+
+    return unitCircle;
+}
+
+inline void appendTriangle(sf::VertexArray& array, sf::Vector2f a, sf::Vector2f b, sf::Vector2f c, sf::Color color) {
+    array.append(sf::Vertex{a, color});
+    array.append(sf::Vertex{b, color});
+    array.append(sf::Vertex{c, color});
+}
+
+// fills a convex polygon as a triangle fan
+inline void appendFan(sf::VertexArray& array, const sf::Vector2f* points, u32 count, sf::Color color) {
+    for (u32 i = 1; i + 1 < count; i++)
+        appendTriangle(array, points[0], points[i], points[i + 1], color);
+}
+
+// fills the band between two closed outlines with the same number of points
+inline void appendRing(sf::VertexArray& array, const sf::Vector2f* outer, const sf::Vector2f* inner, u32 count, sf::Color color) {
+    for (u32 i = 0; i < count; i++) {
+        u32 next = (i + 1) % count;
+        appendTriangle(array, outer[i], outer[next], inner[i], color);
+        appendTriangle(array, inner[i], outer[next], inner[next], color);
+    }
+}
+
+inline void appendCircle(sf::VertexArray& array, sf::Vector2f center, float radius, sf::Color fill, float outlineThickness = 0.0f, sf::Color outline = sf::Color::Transparent) {
+    const std::array<sf::Vector2f, circleSegments>& unitCircle = getUnitCircle();
+
+    std::array<sf::Vector2f, circleSegments> outer;
+    for (u32 i = 0; i < circleSegments; i++)
+        outer[i] = center + unitCircle[i] * radius;
+
+    appendFan(array, outer.data(), circleSegments, fill);
+
+    if (outlineThickness <= 0.0f)
+        return;
+
+    std::array<sf::Vector2f, circleSegments> inner;
+    for (u32 i = 0; i < circleSegments; i++)
+        inner[i] = center + unitCircle[i] * (radius - outlineThickness);
+
+    appendRing(array, outer.data(), inner.data(), circleSegments, outline);
+}
+
+// a rectangle of size centered on center and rotated by rotation radians
+inline void appendRectangle(sf::VertexArray& array, sf::Vector2f center, sf::Vector2f size, float rotation, sf::Color fill, float outlineThickness = 0.0f, sf::Color outline = sf::Color::Transparent) {
+    sf::Vector2f axisX = sf::Vector2f(std::cos(rotation), std::sin(rotation));
+    sf::Vector2f axisY = axisX.perpendicular();
+
+    auto corners = [&](sf::Vector2f halfSize) {
+        sf::Vector2f x = axisX * halfSize.x;
+        sf::Vector2f y = axisY * halfSize.y;
+        return std::array<sf::Vector2f, 4>{center - x - y, center + x - y, center + x + y, center - x + y};
+    };
+
+    std::array<sf::Vector2f, 4> outer = corners(size / 2.0f);
+    if (fill != sf::Color::Transparent)
+        appendFan(array, outer.data(), 4, fill);
+
+    if (outlineThickness <= 0.0f)
+        return;
+
+    std::array<sf::Vector2f, 4> inner = corners(size / 2.0f - sf::Vector2f(outlineThickness, outlineThickness));
+    appendRing(array, outer.data(), inner.data(), 4, outline);
+}
+
+// Local space triangles of every polygon that has been drawn, keyed by entity.
+// Asteroid shapes do not change after they spawn, so the fan is built once
+// from the world vertices and only moved by the entity's transform after that.
+// A mesh is dropped whenever the entity's ShapeComponent is set again and
+// whenever a disabled entity is enabled, which both happen when a pooled
+// asteroid is acquired with a new shape.
+class MeshCache {
+public:
+    // shape must be a polygon, it is only cast when the mesh is not cached yet
+    const std::vector<sf::Vector2f>& get(flecs::entity_t entity, ae::Shape& shape, const ae::TransformComponent& transform) {
+        auto it = meshes.find(entity);
+        if (it != meshes.end())
+            return it->second;
+
+        ae::Polygon& polygon = dynamic_cast<ae::Polygon&>(shape);
+        std::vector<sf::Vector2f>& mesh = meshes[entity];
+        ae::Polygon::vertices_t vertices = polygon.getWorldVertices();
+
+        // undoes the transform so the mesh can be placed by any later one
+        sf::Vector2f pos = transform.getPos();
+        float cos = std::cos(-transform.getRot());
+        float sin = std::sin(-transform.getRot());
+        auto toLocal = [&](sf::Vector2f world) {
+            sf::Vector2f offset = world - pos;
+            return sf::Vector2f(offset.x * cos - offset.y * sin, offset.x * sin + offset.y * cos);
+        };
+
+        for (u8 i = 1; i + 1 < polygon.getVerticeCount(); i++) {
+            mesh.push_back(toLocal(vertices[0]));
+            mesh.push_back(toLocal(vertices[i + 0]));
+            mesh.push_back(toLocal(vertices[i + 1]));
+        }
+
+        return mesh;
+    }
+
+    // nullptr until get() has built the mesh
+    const std::vector<sf::Vector2f>* find(flecs::entity_t entity) const {
+        auto it = meshes.find(entity);
+        return it == meshes.end() ? nullptr : &it->second;
+    }
+
+    void invalidate(flecs::entity_t entity) {
+        meshes.erase(entity);
+    }
+
+private:
+    std::unordered_map<flecs::entity_t, std::vector<sf::Vector2f>> meshes;
+};
+
+// places a cached mesh at pos rotated by rot radians
+inline void appendMesh(sf::VertexArray& array, const std::vector<sf::Vector2f>& mesh, sf::Vector2f pos, float rot, sf::Color color) {
+    float cos = std::cos(rot);
+    float sin = std::sin(rot);
+
+    for (sf::Vector2f local : mesh) {
+        sf::Vector2f world = sf::Vector2f(local.x * cos - local.y * sin, local.x * sin + local.y * cos) + pos;
+        array.append(sf::Vertex{world, color});
+    }
+}
+
+enum class RenderKind: u8 {
+    Turret,
+    Bullet,
+    Polygon,
+    Circle
+};
+
+struct RenderItem {
+    flecs::entity_t entity;
+    RenderKind kind;
+    sf::Vector2f pos;
+    float rot;
+    float radius;
+    sf::Color color;
+};
+
+// Everything needed to draw one tick, copied out of the world so drawing never
+// reads components while the simulation is writing them.
+struct RenderSnapshot {
+    std::vector<RenderItem> items;
+};
+
+// Captures a snapshot of the scene after every frame that simulated at least
+// one fixed step into one half of a double buffer, and draws by interpolating
+// between the two latest snapshots by how far the frame is into the next step.
+// Motion stays smooth when frames and steps do not line up, drawing lags one
+// step behind the simulation in exchange. A frame that simulated several steps
+// leaves its snapshot that many steps after the one before, which draw() takes
+// into account so every step still takes the same time on screen.
+class SceneRenderer {
+public:
+    explicit SceneRenderer(flecs::world& world);
+
+    // copies the current state of the world into the next snapshot, steps is
+    // how many fixed steps were simulated since the last one
+    void capture(ae::PhysicsWorld& physicsWorld, u32 steps = 1);
+
+    // alpha is the fraction of a step since the latest snapshot, returns the
+    // number of target.draw() calls made, 0 when there was nothing to draw
+    u32 draw(sf::RenderTarget& target, bool debugShow, float alpha);
+    void drawDebugLabels(sf::RenderTarget& target, sf::Text& text);
+
+private:
+    const RenderItem* findPrevious(flecs::entity_t entity) const;
+
+private:
+    flecs::world world;
+    flecs::query<TurretComponent, ae::TransformComponent> turretQuery;
+    flecs::query<BulletComponent, ae::TransformComponent, ColorComponent> bulletQuery;
+    flecs::query<ae::ShapeComponent, ColorComponent, ae::TransformComponent> shapeQuery;
+
+    MeshCache meshCache;
+    std::array<RenderSnapshot, 2> snapshots;
+    u32 current = 0;
+    u32 stepsBetween = 1; // fixed steps between the two snapshots
+    std::unordered_map<flecs::entity_t, u32> previousIndex;
+    sf::VertexArray array = sf::VertexArray(sf::PrimitiveType::Triangles);
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include "base.hpp"
+#include <fstream>
+
+constexpr const char* matchStatsPath = "./match_stats.csv";
+
+// Outcome and cost of one match on the host. When the match ends it is
+// appended as one row to matchStatsPath, or the file asteroids_batch is given,
+// next to the config values that are usually tuned, so runs with different
+// configs can be compared.
+struct MatchStats {
+    u32 matchesPlayed = 0;
+    double startTime = 0.0;
+    u32 asteroidsDestroyed = 0;
+    u32 bulletsFired = 0;
+    u32 turretsPlaced = 0;
+    u64 ticks = 0;
+    double tickTimeSum = 0.0;
+    float peakTickTime = 0.0f;
+
+    void begin(double now) {
+        startTime = now;
+        asteroidsDestroyed = 0;
+        bulletsFired = 0;
+        turretsPlaced = 0;
+        ticks = 0;
+        tickTimeSum = 0.0;
+        peakTickTime = 0.0f;
+    }
+
+    void recordTick(float tickTime) {
+        ticks++;
+        tickTimeSum += tickTime;
+        peakTickTime = std::max(peakTickTime, tickTime);
+    }
+
+    void write(double now, i32 score, const char* path = matchStatsPath) {
+        matchesPlayed++;
+
+        std::ifstream existing(path);
+        bool writeHeader = !existing.good() || existing.peek() == std::ifstream::traits_type::eof();
+        existing.close();
+
+        std::ofstream file(path, std::ios::app);
+        if (!file.is_open()) {
+            ae::log(ae::ERROR_SEVERITY_WARNING, "Failed to open %s\n", path);
+            return;
+        }
+
+        if (writeHeader) {
+            file << "match,duration,score,asteroids_destroyed,bullets_fired,turrets_placed,avg_tick_ms,peak_tick_ms,"
+                    "time_per_asteroid_spawn,time_to_remove_per_asteroid_spawn,turret_range,max_turrets,player_fire_rate\n";
+        }
+
+        double averageTickTime = ticks == 0 ? 0.0 : tickTimeSum / (double)ticks;
+        file << matchesPlayed << ','
+             << now - startTime << ','
+             << score << ','
+             << asteroidsDestroyed << ','
+             << bulletsFired << ','
+             << turretsPlaced << ','
+             << averageTickTime * 1000.0 << ','
+             << peakTickTime * 1000.0f << ','
+             << config.timePerAsteroidSpawn << ','
+             << config.timeToRemovePerAsteroidSpawn << ','
+             << config.turretRange << ','
+             << config.maxTurrets << ','
+             << config.playerFireRate << '\n';
+    }
+};
+
+struct MatchStatsComponent {
+    std::shared_ptr<MatchStats> stats;
+};
+
+inline MatchStats& getMatchStats(const flecs::world& world) {
+    return *world.get<MatchStatsComponent>()->stats;
+}
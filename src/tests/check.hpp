@@ -0,0 +1,14 @@
+#pragma once
+#include "base.hpp"
+
+// Minimal checks for the test targets. A failed check is printed and counted,
+// and main returns the count so ctest sees the failure.
+inline u32 failedChecks = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failedChecks++; \
+        } \
+    } while (0)
@@ -0,0 +1,51 @@
+#include "bench/scenario.hpp"
+#include "check.hpp"
+
+// Checks the wave spawning in asteroidAddUpdate on a headless host world.
+
+constexpr float testStep = 1.0f / 60.0f;
+
+// Once the spawn interval has shrunk below 0 one asteroid has to be spawned
+// every step, the rate must neither drop nor stop.
+void testOnePerStepFallback(flecs::world& world) {
+    flecs::system addAsteroids = world.system<MapSizeComponent, AsteroidTimerComponent>()
+        .term_at(1).singleton().term_at(2).singleton().kind(0).iter(asteroidAddUpdate);
+    AggregateIndex& index = getAggregateIndex(world);
+
+    config.timeToRemovePerAsteroidSpawn = 0.05f;
+    world.set([](AsteroidTimerComponent& timer) {
+        timer.resetTime = 0.2f;
+        timer.current = 0.0f;
+    });
+
+    for (u32 i = 0; i < 1000 && world.get<AsteroidTimerComponent>()->resetTime >= 0.0f; i++) {
+        addAsteroids.run(testStep);
+        getTickArena(world).reset();
+    }
+    CHECK(world.get<AsteroidTimerComponent>()->resetTime < 0.0f);
+
+    for (u32 i = 0; i < 120; i++) {
+        u32 before = index.asteroids;
+        addAsteroids.run(testStep);
+        getTickArena(world).reset();
+        CHECK(index.asteroids == before + 1);
+    }
+
+    addAsteroids.destruct();
+}
+
+int main() {
+    flecs::world& world = ae::getEntityWorld();
+    if (!setupHostWorld(world)) {
+        std::fprintf(stderr, "Failed to load resources\n");
+        return 1;
+    }
+
+    testOnePerStepFallback(world);
+    clearScenario(world);
+
+    if (failedChecks != 0)
+        std::fprintf(stderr, "%u checks failed\n", failedChecks);
+
+    return failedChecks == 0 ? 0 : 1;
+}
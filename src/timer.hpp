@@ -0,0 +1,113 @@
+#pragma once
+#include "base.hpp"
+
+// Hierarchical timer wheel. Timers are bucketed by the tick they expire on, so
+// advancing only touches the buckets that come due instead of every timer.
+// Each level covers 64 times the range of the level below it, and timers in a
+// higher level are moved down a level whenever the level below wraps around.
+class TimerWheel {
+public:
+    using Callback = std::function<void(flecs::entity)>;
+    using Handle = u64;
+
+    explicit TimerWheel(float resolution)
+        : resolution(resolution) {}
+
+    Handle schedule(float delay, flecs::entity entity, Callback callback) {
+        u64 ticks = (u64)std::max(std::ceil((accumulator + delay) / resolution), 1.0f);
+        ticks = std::min(ticks, maxTicks);
+
+        Handle handle = nextHandle++;
+        insert({handle, currentTick + ticks, entity, std::move(callback)});
+        live.insert(handle);
+
+        return handle;
+    }
+
+    // cancelled timers are dropped lazily once their bucket is reached, handles
+    // that already fired or were cancelled before are ignored
+    void cancel(Handle handle) {
+        live.erase(handle);
+    }
+
+    // runs the callback of every timer that came due during deltaTime
+    void advance(float deltaTime) {
+        time += deltaTime;
+        accumulator += deltaTime;
+
+        while (accumulator >= resolution) {
+            accumulator -= resolution;
+            tick();
+        }
+    }
+
+    // seconds the wheel has been advanced by, usable as a clock for deadlines
+    double now() const { return time; }
+    size_t size() const { return live.size(); }
+
+private:
+    static constexpr u32 levelBits = 6;
+    static constexpr u32 slotCount = 1 << levelBits;
+    static constexpr u32 levelCount = 4;
+    static constexpr u64 maxTicks = ((u64)1 << (levelBits * (levelCount - 1))) * (slotCount - 1);
+
+    struct Timer {
+        Handle handle;
+        u64 expiry;
+        flecs::entity entity;
+        Callback callback;
+    };
+
+    void insert(Timer&& timer) {
+        // the lowest level whose bucket currentTick will still pass through
+        u32 level = 0;
+        while (level + 1 < levelCount &&
+               (timer.expiry >> (levelBits * (level + 1))) != (currentTick >> (levelBits * (level + 1))))
+            level++;
+
+        u64 slot = (timer.expiry >> (levelBits * level)) & (slotCount - 1);
+        wheels[level][slot].push_back(std::move(timer));
+    }
+
+    bool isLive(const Timer& timer) const {
+        return live.find(timer.handle) != live.end();
+    }
+
+    void tick() {
+        currentTick++;
+
+        for (u32 level = 1; level < levelCount; level++) {
+            if ((currentTick & (((u64)1 << (levelBits * level)) - 1)) != 0)
+                break;
+
+            u64 slot = (currentTick >> (levelBits * level)) & (slotCount - 1);
+            std::vector<Timer> cascade = std::move(wheels[level][slot]);
+            wheels[level][slot].clear();
+
+            for (Timer& timer : cascade) {
+                if (isLive(timer))
+                    insert(std::move(timer));
+            }
+        }
+
+        // swapped out so callbacks are free to schedule new timers
+        std::vector<Timer> due = std::move(wheels[0][currentTick & (slotCount - 1)]);
+        wheels[0][currentTick & (slotCount - 1)].clear();
+
+        for (Timer& timer : due) {
+            if (live.erase(timer.handle) == 0)
+                continue;
+
+            timer.callback(timer.entity);
+        }
+    }
+
+private:
+    std::array<std::array<std::vector<Timer>, slotCount>, levelCount> wheels;
+    std::unordered_set<Handle> live; // scheduled and neither fired nor cancelled, so it never outgrows the wheel
+    float resolution;
+    float accumulator = 0.0f;
+    double time = 0.0;
+    u64 currentTick = 0;
+    Handle nextHandle = 1;
+};